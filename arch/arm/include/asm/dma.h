@@ -7,10 +7,12 @@
 
 #include <common.h>
 
+#define DMA_ALIGNMENT	64
+
 #define dma_alloc dma_alloc
 static inline void *dma_alloc(size_t size)
 {
-	return xmemalign(64, ALIGN(size, 64));
+	return xmemalign(DMA_ALIGNMENT, ALIGN(size, DMA_ALIGNMENT));
 }
 
 #ifndef CONFIG_MMU
@@ -19,8 +19,11 @@
 #include <common.h>
 #include <block.h>
 #include <malloc.h>
+#include <param.h>
 #include <linux/err.h>
 #include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 #include <dma.h>
 
 #define BLOCKSIZE(blk)	(1 << blk->blockbits)
@@ -32,17 +35,28 @@ struct chunk {
 	void *data; /* data buffer */
 	int block_start; /* first block in this chunk */
 	int dirty; /* need to write back to device */
+	int readahead; /* read ahead and not yet accessed */
 	int num; /* number of chunk, debugging only */
-	struct list_head list;
+	struct list_head list; /* position in the LRU or idle list */
+	struct hlist_node hash; /* hash bucket, only valid while cached */
 };
 
 #define BUFSIZE (PAGE_SIZE * 4)
+#define NUM_CHUNKS	32
+#define MAX_BUFSIZE	SZ_1M
+#define MAX_CHUNKS	4096
+#define READAHEAD	SZ_256K
 
 static int writebuffer_io_len(struct block_device *blk, struct chunk *chunk)
 {
 	return min(blk->rdbufsize, blk->num_blocks - chunk->block_start);
 }
 
+static struct hlist_head *chunk_hash_head(struct block_device *blk, int block)
+{
+	return &blk->chunk_hash[(block >> blk->rdbufbits) & blk->chunk_hash_mask];
+}
+
 /*
  * Write all dirty chunks back to the device
  */
@@ -72,6 +86,19 @@ static int writebuffer_flush(struct block_device *blk)
 	return 0;
 }
 
+static struct chunk *chunk_find(struct block_device *blk, int block)
+{
+	struct chunk *chunk;
+	struct hlist_node *pos;
+	int block_start = block & ~blk->blkmask;
+
+	hlist_for_each_entry(chunk, pos, chunk_hash_head(blk, block), hash)
+		if (chunk->block_start == block_start)
+			return chunk;
+
+	return NULL;
+}
+
 /*
  * get the chunk containing a given block. Will return NULL if the
  * block is not cached, the chunk otherwise.
@@ -80,20 +107,23 @@ static struct chunk *chunk_get_cached(struct block_device *blk, int block)
 {
 	struct chunk *chunk;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (block >= chunk->block_start &&
-				block < chunk->block_start + blk->rdbufsize) {
-			dev_dbg(blk->dev, "%s: found %d in %d\n", __func__,
-				block, chunk->num);
-			/*
-			 * move most recently used entry to the head of the list
-			 */
-			list_move(&chunk->list, &blk->buffered_blocks);
-			return chunk;
-		}
+	chunk = chunk_find(blk, block);
+	if (!chunk)
+		return NULL;
+
+	dev_dbg(blk->dev, "%s: found %d in %d\n", __func__, block, chunk->num);
+
+	if (chunk->readahead) {
+		chunk->readahead = 0;
+		blk->readahead_hits++;
 	}
 
-	return NULL;
+	/*
+	 * move most recently used entry to the head of the list
+	 */
+	list_move(&chunk->list, &blk->buffered_blocks);
+
+	return chunk;
 }
 
 /*
@@ -133,6 +163,9 @@ static struct chunk *get_chunk(struct block_device *blk)
 
 			chunk->dirty = 0;
 		}
+
+		hlist_del_init(&chunk->hash);
+		blk->cache_evictions++;
 	} else {
 		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
 	}
@@ -142,6 +175,74 @@ static struct chunk *get_chunk(struct block_device *blk)
 	return chunk;
 }
 
+/*
+ * Determine how many chunks to read starting at @block_start. A miss on
+ * the chunk following the last one read is considered a sequential
+ * access and doubles the readahead window, any other miss resets it.
+ */
+static int block_readahead_window(struct block_device *blk, int block_start)
+{
+	if (block_start == blk->readahead_next)
+		blk->readahead_window = min(blk->readahead_window * 2,
+					    blk->readahead_max);
+	else
+		blk->readahead_window = 1;
+
+	return blk->readahead_window;
+}
+
+/*
+ * Read @nchunks chunks starting at @block_start with a single request
+ * and put them into the cache. The window is shortened at the end of
+ * the device and at the first chunk which is already cached.
+ */
+static int block_readahead(struct block_device *blk, int block_start,
+			   int nchunks)
+{
+	struct chunk *chunk;
+	int i, num_blocks, ret;
+
+	for (i = 1; i < nchunks; i++) {
+		int block = block_start + i * blk->rdbufsize;
+
+		if (block >= blk->num_blocks || chunk_find(blk, block))
+			break;
+	}
+
+	nchunks = i;
+	num_blocks = min(nchunks * blk->rdbufsize,
+			 blk->num_blocks - block_start);
+
+	dev_dbg(blk->dev, "%s: %d chunks at %d\n", __func__, nchunks,
+		block_start);
+
+	ret = blk->ops->read(blk, blk->readahead_buf, block_start, num_blocks);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < nchunks; i++) {
+		chunk = get_chunk(blk);
+		if (IS_ERR(chunk))
+			return PTR_ERR(chunk);
+
+		chunk->block_start = block_start + i * blk->rdbufsize;
+		chunk->readahead = i > 0;
+
+		memcpy(chunk->data, blk->readahead_buf + i * blk->cache_chunksize,
+		       writebuffer_io_len(blk, chunk) << blk->blockbits);
+
+		list_add(&chunk->list, &blk->buffered_blocks);
+		hlist_add_head(&chunk->hash,
+			       chunk_hash_head(blk, chunk->block_start));
+	}
+
+	blk->readahead_next = block_start + nchunks * blk->rdbufsize;
+	blk->readahead_ios++;
+	blk->readahead_chunks += nchunks - 1;
+
+	return 0;
+}
+
 /*
  * read a block into the cache. This assumes that the block is
  * not cached already. By definition block_get_cached() for
@@ -150,7 +251,17 @@ static struct chunk *get_chunk(struct block_device *blk)
 static int block_cache(struct block_device *blk, int block)
 {
 	struct chunk *chunk;
-	int ret;
+	int ret, nchunks;
+
+	nchunks = block_readahead_window(blk, block & ~blk->blkmask);
+	if (nchunks > 1) {
+		ret = block_readahead(blk, block & ~blk->blkmask, nchunks);
+		if (!ret)
+			return 0;
+
+		/* retry without readahead */
+		blk->readahead_window = 1;
+	}
 
 	chunk = get_chunk(blk);
 	if (IS_ERR(chunk))
@@ -168,6 +279,10 @@ static int block_cache(struct block_device *blk, int block)
 		return ret;
 	}
 	list_add(&chunk->list, &blk->buffered_blocks);
+	hlist_add_head(&chunk->hash, chunk_hash_head(blk, chunk->block_start));
+
+	chunk->readahead = 0;
+	blk->readahead_next = chunk->block_start + blk->rdbufsize;
 
 	return 0;
 }
@@ -185,8 +300,12 @@ static void *block_get(struct block_device *blk, int block)
 		return ERR_PTR(-ENXIO);
 
 	outdata = block_get_cached(blk, block);
-	if (outdata)
+	if (outdata) {
+		blk->cache_hits++;
 		return outdata;
+	}
+
+	blk->cache_misses++;
 
 	ret = block_cache(blk, block);
 	if (ret)
@@ -199,6 +318,44 @@ static void *block_get(struct block_device *blk, int block)
 	return outdata;
 }
 
+/*
+ * Read full blocks directly into the callers buffer, bypassing the cache.
+ * This is only done for spans of at least one chunk which are not cached,
+ * so that data in the cache (which may be dirty) always takes precedence.
+ * Returns the number of blocks read or 0 if the block at @block should
+ * be read through the cache instead.
+ */
+static int block_read_direct(struct block_device *blk, void *buf, int block,
+			     int num_blocks)
+{
+	int i = 0, ret;
+
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT))
+		return 0;
+
+	num_blocks = min(num_blocks, blk->num_blocks - block);
+	if (num_blocks < blk->rdbufsize)
+		return 0;
+
+	while (i < num_blocks) {
+		if (chunk_find(blk, block + i))
+			break;
+		i += blk->rdbufsize - ((block + i) & blk->blkmask);
+	}
+
+	num_blocks = min(i, num_blocks);
+	if (num_blocks < blk->rdbufsize)
+		return 0;
+
+	dev_dbg(blk->dev, "%s: %d blocks at %d\n", __func__, num_blocks, block);
+
+	ret = blk->ops->read(blk, buf, block, num_blocks);
+	if (ret)
+		return ret;
+
+	return num_blocks;
+}
+
 static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 		loff_t offset, unsigned long flags)
 {
@@ -226,16 +383,26 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	blocks = count >> blk->blockbits;
 
 	while (blocks) {
-		void *iobuf = block_get(blk, block);
+		int now;
 
-		if (IS_ERR(iobuf))
-			return PTR_ERR(iobuf);
+		now = block_read_direct(blk, buf, block, blocks);
+		if (now < 0)
+			return now;
 
-		memcpy(buf, iobuf, BLOCKSIZE(blk));
-		buf += BLOCKSIZE(blk);
-		blocks--;
-		block++;
-		count -= BLOCKSIZE(blk);
+		if (!now) {
+			void *iobuf = block_get(blk, block);
+
+			if (IS_ERR(iobuf))
+				return PTR_ERR(iobuf);
+
+			memcpy(buf, iobuf, BLOCKSIZE(blk));
+			now = 1;
+		}
+
+		buf += now << blk->blockbits;
+		blocks -= now;
+		block += now;
+		count -= now << blk->blockbits;
 	}
 
 	if (count) {
@@ -351,38 +518,238 @@ static struct cdev_operations block_ops = {
 	.flush	= block_op_flush,
 };
 
+static void block_cache_free(struct block_device *blk)
+{
+	struct chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+
+	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+
+	INIT_LIST_HEAD(&blk->buffered_blocks);
+	INIT_LIST_HEAD(&blk->idle_blocks);
+
+	free(blk->chunk_hash);
+	blk->chunk_hash = NULL;
+
+	dma_free(blk->readahead_buf);
+	blk->readahead_buf = NULL;
+}
+
+/*
+ * Like dma_alloc(), but return NULL instead of panicking, so that a cache
+ * size set by the user which does not fit into memory can be rejected.
+ */
+static void *block_dma_alloc(size_t size)
+{
+	return memalign(DMA_ALIGNMENT, ALIGN(size, DMA_ALIGNMENT));
+}
+
+/*
+ * Allocate a cache with the current cache_* parameters. The previous cache
+ * is only replaced once the new one is complete, so on failure the device
+ * keeps working with the cache it had before.
+ */
+static int block_cache_alloc(struct block_device *blk)
+{
+	LIST_HEAD(chunks);
+	struct chunk *chunk, *tmp;
+	struct hlist_head *hash;
+	void *readahead_buf = NULL;
+	int readahead_max;
+	unsigned int nhash;
+	int i;
+
+	nhash = roundup_pow_of_two(blk->cache_chunks);
+	hash = calloc(nhash, sizeof(*hash));
+	if (!hash)
+		return -ENOMEM;
+
+	for (i = 0; i < blk->cache_chunks; i++) {
+		chunk = calloc(1, sizeof(*chunk));
+		if (!chunk)
+			goto err_free;
+
+		chunk->data = block_dma_alloc(blk->cache_chunksize);
+		if (!chunk->data) {
+			free(chunk);
+			goto err_free;
+		}
+
+		chunk->num = i;
+		INIT_HLIST_NODE(&chunk->hash);
+		list_add_tail(&chunk->list, &chunks);
+	}
+
+	/*
+	 * Limit the readahead window to half of the cache so that a
+	 * readahead never evicts the chunks it has just read.
+	 */
+	readahead_max = min(blk->cache_readahead / blk->cache_chunksize,
+			    blk->cache_chunks / 2);
+	if (readahead_max > 1)
+		readahead_buf = block_dma_alloc(readahead_max *
+					       blk->cache_chunksize);
+	if (!readahead_buf)
+		readahead_max = 1;
+
+	block_cache_free(blk);
+
+	blk->rdbufsize = blk->cache_chunksize >> blk->blockbits;
+	blk->rdbufbits = ilog2(blk->rdbufsize);
+	blk->blkmask = blk->rdbufsize - 1;
+
+	list_splice(&chunks, &blk->idle_blocks);
+	blk->chunk_hash = hash;
+	blk->chunk_hash_mask = nhash - 1;
+
+	blk->readahead_buf = readahead_buf;
+	blk->readahead_max = readahead_max;
+	blk->readahead_window = 1;
+	blk->readahead_next = -1;
+
+	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x chunks: %u\n",
+		blk->rdbufsize, blk->blockbits, blk->blkmask, blk->cache_chunks);
+
+	return 0;
+
+err_free:
+	list_for_each_entry_safe(chunk, tmp, &chunks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+	free(hash);
+
+	return -ENOMEM;
+}
+
+static int block_cache_set(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+	int ret;
+
+	if (!is_power_of_2(blk->cache_chunksize) ||
+	    blk->cache_chunksize < BLOCKSIZE(blk) ||
+	    blk->cache_chunksize > MAX_BUFSIZE)
+		return -EINVAL;
+
+	if (!blk->cache_chunks || blk->cache_chunks > MAX_CHUNKS)
+		return -EINVAL;
+
+	ret = writebuffer_flush(blk);
+	if (ret)
+		return ret;
+
+	/*
+	 * On failure the old cache stays in place and the parameter core
+	 * restores the previous value of the parameter being set.
+	 */
+	return block_cache_alloc(blk);
+}
+
+static struct param_d *block_add_param(struct block_device *blk,
+		const char *prefix, const char *name,
+		int (*set)(struct param_d *p, void *priv), uint32_t *value)
+{
+	struct param_d *p;
+	char *pname;
+
+	pname = xasprintf("%s%s", prefix, name);
+	p = dev_add_param_uint32(blk->dev, pname, set, NULL, value, "%u", blk);
+	free(pname);
+
+	return p;
+}
+
+static void block_cache_add_params(struct block_device *blk)
+{
+	const char *devname = dev_name(blk->dev);
+	const char *name = blk->cdev.name;
+	int len = strlen(devname);
+	char *prefix;
+
+	/*
+	 * Several block devices can share one device (e.g. the hardware
+	 * partitions of an eMMC), so prefix the parameters with the part
+	 * of the cdev name that makes them unique.
+	 */
+	if (!strcmp(name, devname))
+		prefix = xstrdup("");
+	else if (!strncmp(name, devname, len) && name[len] == '.')
+		prefix = xasprintf("%s.", name + len + 1);
+	else
+		prefix = xasprintf("%s.", name);
+
+	blk->params[0] = block_add_param(blk, prefix, "cache_chunksize",
+					 block_cache_set, &blk->cache_chunksize);
+	blk->params[1] = block_add_param(blk, prefix, "cache_chunks",
+					 block_cache_set, &blk->cache_chunks);
+	blk->params[2] = block_add_param(blk, prefix, "cache_hits",
+					 param_set_readonly, &blk->cache_hits);
+	blk->params[3] = block_add_param(blk, prefix, "cache_misses",
+					 param_set_readonly, &blk->cache_misses);
+	blk->params[4] = block_add_param(blk, prefix, "cache_evictions",
+					 param_set_readonly, &blk->cache_evictions);
+	blk->params[5] = block_add_param(blk, prefix, "cache_readahead",
+					 block_cache_set, &blk->cache_readahead);
+	blk->params[6] = block_add_param(blk, prefix, "readahead_ios",
+					 param_set_readonly, &blk->readahead_ios);
+	blk->params[7] = block_add_param(blk, prefix, "readahead_chunks",
+					 param_set_readonly, &blk->readahead_chunks);
+	blk->params[8] = block_add_param(blk, prefix, "readahead_hits",
+					 param_set_readonly, &blk->readahead_hits);
+
+	free(prefix);
+}
+
+static void block_cache_remove_params(struct block_device *blk)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(blk->params); i++) {
+		if (!IS_ERR_OR_NULL(blk->params[i]))
+			dev_remove_param(blk->params[i]);
+		blk->params[i] = NULL;
+	}
+}
+
 int blockdevice_register(struct block_device *blk)
 {
 	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
 	int ret;
-	int i;
 
 	blk->cdev.size = size;
 	blk->cdev.dev = blk->dev;
 	blk->cdev.ops = &block_ops;
 	blk->cdev.priv = blk;
-	blk->rdbufsize = BUFSIZE >> blk->blockbits;
 
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
-	blk->blkmask = blk->rdbufsize - 1;
 
-	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x\n",
-		blk->rdbufsize, blk->blockbits, blk->blkmask);
+	blk->cache_chunksize = max_t(uint32_t, BUFSIZE, BLOCKSIZE(blk));
+	blk->cache_chunks = NUM_CHUNKS;
+	blk->cache_readahead = READAHEAD;
 
-	for (i = 0; i < 32; i++) {
-		struct chunk *chunk = xzalloc(sizeof(*chunk));
-		chunk->data = dma_alloc(BUFSIZE);
-		chunk->num = i;
-		list_add_tail(&chunk->list, &blk->idle_blocks);
-	}
+	ret = block_cache_alloc(blk);
+	if (ret)
+		return ret;
 
 	ret = devfs_create(&blk->cdev);
-	if (ret)
+	if (ret) {
+		block_cache_free(blk);
 		return ret;
+	}
 
 	list_add_tail(&blk->list, &block_device_list);
 
+	block_cache_add_params(blk);
+
 	cdev_create_default_automount(&blk->cdev);
 
 	return 0;
@@ -390,19 +757,10 @@ int blockdevice_register(struct block_device *blk)
 
 int blockdevice_unregister(struct block_device *blk)
 {
-	struct chunk *chunk, *tmp;
-
 	writebuffer_flush(blk);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
-
-	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	block_cache_remove_params(blk);
+	block_cache_free(blk);
 
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
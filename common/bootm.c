@@ -111,15 +111,23 @@ int bootm_load_os(struct image_data *data, unsigned long load_address)
 	if (load_address == UIMAGE_INVALID_ADDRESS)
 		return -EINVAL;
 
-	if (data->os_fit) {
-		const void *kernel = data->fit_kernel;
+	if (IS_ENABLED(CONFIG_FITIMAGE) && data->os_fit) {
 		unsigned long kernel_size = data->fit_kernel_size;
+		int ret;
 
 		data->os_res = request_sdram_region("kernel",
 				load_address, kernel_size);
 		if (!data->os_res)
 			return -ENOMEM;
-		memcpy((void *)load_address, kernel, kernel_size);
+
+		ret = fit_load_image(data->os_fit, data->fit_config, "kernel",
+				     (void *)load_address, kernel_size);
+		if (ret) {
+			release_sdram_region(data->os_res);
+			data->os_res = NULL;
+			return ret;
+		}
+
 		return 0;
 	}
 
@@ -216,18 +224,27 @@ int bootm_load_initrd(struct image_data *data, unsigned long load_address)
 
 	if (IS_ENABLED(CONFIG_FITIMAGE) && data->os_fit &&
 	    fit_has_image(data->os_fit, data->fit_config, "ramdisk")) {
-		const void *initrd;
 		unsigned long initrd_size;
 
-		ret = fit_open_image(data->os_fit, data->fit_config, "ramdisk",
-				     &initrd, &initrd_size);
+		ret = fit_get_image_size(data->os_fit, data->fit_config,
+					 "ramdisk", &initrd_size);
+		if (ret)
+			return ret;
 
 		data->initrd_res = request_sdram_region("initrd",
 				load_address,
 				initrd_size);
 		if (!data->initrd_res)
 			return -ENOMEM;
-		memcpy((void *)load_address, initrd, initrd_size);
+
+		ret = fit_load_image(data->os_fit, data->fit_config, "ramdisk",
+				     (void *)load_address, initrd_size);
+		if (ret) {
+			release_sdram_region(data->initrd_res);
+			data->initrd_res = NULL;
+			return ret;
+		}
+
 		printf("Loaded initrd from FIT image\n");
 		goto done1;
 	}
@@ -619,10 +636,24 @@ int bootm_boot(struct bootm_data *bootm_data)
 			goto err_out;
 		}
 
-		ret = fit_open_image(data->os_fit, data->fit_config, "kernel",
-				     &data->fit_kernel, &data->fit_kernel_size);
+		ret = fit_get_image_size(data->os_fit, data->fit_config,
+					 "kernel", &data->fit_kernel_size);
 		if (ret)
 			goto err_out;
+
+		/*
+		 * The kernel is verified while it is loaded, which a dry run
+		 * may not do. Read and verify it here instead.
+		 */
+		if (data->dryrun) {
+			const void *kernel;
+			unsigned long kernel_size;
+
+			ret = fit_open_image(data->os_fit, data->fit_config,
+					     "kernel", &kernel, &kernel_size);
+			if (ret)
+				goto err_out;
+		}
 	}
 
 	if (os_type == filetype_uimage) {
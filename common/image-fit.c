@@ -26,11 +26,14 @@
 #include <digest.h>
 #include <of.h>
 #include <fs.h>
+#include <fcntl.h>
+#include <linux/stat.h>
 #include <malloc.h>
 #include <linux/ctype.h>
 #include <asm/byteorder.h>
 #include <errno.h>
 #include <linux/err.h>
+#include <linux/sizes.h>
 #include <stringlist.h>
 #include <rsa.h>
 #include <image-fit.h>
@@ -372,13 +375,26 @@ static int fit_verify_signature(struct device_node *sig_node, const void *fit)
 	return ret;
 }
 
-static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
-			   const void *data, int data_len)
+/*
+ * Verification of an image is split into init, update and final, so that
+ * the digest can be computed while the image is copied to its destination
+ * instead of in a separate pass over the data.
+ */
+struct fit_verify {
+	struct digest *digest;	/* NULL if there is nothing to check */
+	struct device_node *node;	/* hash or signature node */
+	const char *value;	/* expected hash */
+	enum hash_algo algo;	/* signatures only */
+	bool signature;
+};
+
+static int fit_verify_hash_init(struct fit_handle *handle,
+				struct device_node *image,
+				struct fit_verify *v)
 {
 	struct digest *d;
 	const char *algo;
 	const char *value_read;
-	char *value_calc;
 	int hash_len, ret;
 	struct device_node *hash;
 
@@ -421,40 +437,48 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 
 	if (hash_len != digest_length(d)) {
 		pr_err("%s: invalid hash length %d\n", hash->full_name, hash_len);
-		ret = -EINVAL;
-		goto err_digest_free;
+		digest_free(d);
+		return -EINVAL;
 	}
 
+	digest_init(d);
+
+	v->digest = d;
+	v->node = hash;
+	v->value = value_read;
+
+	return 0;
+}
+
+static int fit_verify_hash_final(struct fit_verify *v)
+{
+	int hash_len = digest_length(v->digest);
+	char *value_calc;
+	int ret;
+
 	value_calc = xmalloc(hash_len);
 
-	digest_init(d);
-	digest_update(d, data, data_len);
-	digest_final(d, value_calc);
+	digest_final(v->digest, value_calc);
 
-	if (memcmp(value_read, value_calc, hash_len)) {
-		pr_info("%s: hash BAD\n", hash->full_name);
+	if (memcmp(v->value, value_calc, hash_len)) {
+		pr_info("%s: hash BAD\n", v->node->full_name);
 		ret =  -EBADMSG;
 	} else {
-		pr_info("%s: hash OK\n", hash->full_name);
+		pr_info("%s: hash OK\n", v->node->full_name);
 		ret = 0;
 	}
 
 	free(value_calc);
 
-err_digest_free:
-	digest_free(d);
-
 	return ret;
 }
 
-static int fit_image_verify_signature(struct fit_handle *handle,
-				      struct device_node *image,
-				      const void *data, int data_len)
+static int fit_image_verify_signature_init(struct fit_handle *handle,
+					   struct device_node *image,
+					   struct fit_verify *v)
 {
 	struct digest *digest;
 	struct device_node *sig_node;
-	enum hash_algo algo = 0;
-	void *hash;
 	int ret;
 
 	if (!IS_ENABLED(CONFIG_FITIMAGE_SIGNATURE))
@@ -478,23 +502,81 @@ static int fit_image_verify_signature(struct fit_handle *handle,
 		return ret;
 	}
 
-	digest = fit_alloc_digest(sig_node, &algo);
+	digest = fit_alloc_digest(sig_node, &v->algo);
 	if (IS_ERR(digest))
 		return PTR_ERR(digest);
 
-	digest_update(digest, data, data_len);
-	hash = xzalloc(digest_length(digest));
-	digest_final(digest, hash);
+	v->digest = digest;
+	v->node = sig_node;
+	v->signature = true;
 
-	ret = fit_check_rsa_signature(sig_node, algo, hash);
+	return 0;
+}
+
+static int fit_image_verify_signature_final(struct fit_verify *v)
+{
+	void *hash;
+	int ret;
+
+	hash = xzalloc(digest_length(v->digest));
+	digest_final(v->digest, hash);
+
+	ret = fit_check_rsa_signature(v->node, v->algo, hash);
 
 	free(hash);
 
-	digest_free(digest);
+	return ret;
+}
+
+/*
+ * As part of a configuration only the hash of an image is checked, the
+ * configuration signature covers the hash nodes. Without configuration
+ * the signature of the image itself is checked.
+ */
+static int fit_verify_init(struct fit_handle *handle, void *configuration,
+			   struct device_node *image, struct fit_verify *v)
+{
+	memset(v, 0, sizeof(*v));
+
+	if (configuration)
+		return fit_verify_hash_init(handle, image, v);
+	else
+		return fit_image_verify_signature_init(handle, image, v);
+}
+
+static void fit_verify_update(struct fit_verify *v, const void *data,
+			      unsigned long len)
+{
+	if (v->digest)
+		digest_update(v->digest, data, len);
+}
+
+static int fit_verify_final(struct fit_verify *v)
+{
+	int ret;
+
+	if (!v->digest)
+		return 0;
+
+	/* never set without FITIMAGE_SIGNATURE, keeps the RSA code out */
+	if (IS_ENABLED(CONFIG_FITIMAGE_SIGNATURE) && v->signature)
+		ret = fit_image_verify_signature_final(v);
+	else
+		ret = fit_verify_hash_final(v);
+
+	digest_free(v->digest);
+	v->digest = NULL;
 
 	return ret;
 }
 
+static void fit_verify_abort(struct fit_verify *v)
+{
+	if (v->digest)
+		digest_free(v->digest);
+	v->digest = NULL;
+}
+
 int fit_has_image(struct fit_handle *handle, void *configuration,
 		  const char *name)
 {
@@ -510,6 +592,112 @@ int fit_has_image(struct fit_handle *handle, void *configuration,
 	return 1;
 }
 
+/*
+ * Streaming mode: instead of reading the whole FIT image into memory only
+ * its structure and strings blocks are read. The payloads of the "data"
+ * properties of the images are left out, just their position in the file
+ * is recorded. They are read when needed, directly to their final location
+ * where possible. Leaving out "data" doesn't change the regions hashed
+ * for configuration signatures, "data" is excluded from those anyway.
+ */
+struct fit_data {
+	struct list_head list;
+	char *path;		/* full name of the image node */
+	loff_t offset;		/* position of the payload in the file */
+	unsigned long size;
+	void *buf;		/* copy read by fit_open_image() */
+};
+
+static struct fit_data *fit_find_data(struct fit_handle *handle,
+				      struct device_node *image)
+{
+	struct fit_data *fd;
+
+	list_for_each_entry(fd, &handle->data_list, list)
+		if (!strcmp(fd->path, image->full_name))
+			return fd;
+
+	return NULL;
+}
+
+/* Small enough for a chunk to still be in the cache when it is hashed */
+#define FIT_LOAD_CHUNK	SZ_64K
+
+/*
+ * Copy an image to @dest, from the file for @fd or from @data if it is
+ * in memory. Each chunk is passed to the digest right after it has been
+ * copied, so verifying costs no extra pass over the image.
+ */
+static int fit_copy_image(struct fit_handle *handle, struct fit_data *fd,
+			  const void *data, void *dest, unsigned long size,
+			  struct fit_verify *v)
+{
+	unsigned long pos, now;
+	int ret;
+
+	if (fd && lseek(handle->fd, fd->offset, SEEK_SET) != fd->offset)
+		return -errno;
+
+	for (pos = 0; pos < size; pos += now) {
+		now = min_t(unsigned long, size - pos, FIT_LOAD_CHUNK);
+
+		if (fd) {
+			ret = read_full(handle->fd, dest + pos, now);
+			if (ret < 0)
+				return ret;
+			if (ret < now)
+				return -EINVAL;
+		} else {
+			memcpy(dest + pos, data + pos, now);
+		}
+
+		fit_verify_update(v, dest + pos, now);
+	}
+
+	return 0;
+}
+
+/*
+ * Look up the image node @name refers to, either in @configuration or,
+ * if that is NULL, directly in the images node.
+ */
+static struct device_node *fit_get_image(struct fit_handle *handle,
+					 void *configuration, const char *name)
+{
+	struct device_node *image;
+	const char *unit, *type = NULL;
+	struct device_node *conf_node = configuration;
+
+	if (conf_node) {
+		if (of_property_read_string(conf_node, name, &unit)) {
+			pr_err("No image named '%s'\n", name);
+			return ERR_PTR(-ENOENT);
+		}
+	} else {
+		unit = name;
+	}
+
+	image = of_get_child_by_name(handle->images, unit);
+	if (!image)
+		return ERR_PTR(-ENOENT);
+
+	of_property_read_string(image, "type", &type);
+	if (!type) {
+		pr_err("No \"type\" property found in %s\n", image->full_name);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return image;
+}
+
+static void fit_print_image(struct device_node *image)
+{
+	const char *desc = "(no description)";
+
+	of_property_read_string(image, "description", &desc);
+	pr_info("image '%s': '%s'\n", image->name, desc);
+}
+
 /**
  * fit_open_image - Open an image in a FIT image
  * @handle: The FIT image handle
@@ -532,52 +720,162 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 		   unsigned long *outsize)
 {
 	struct device_node *image;
-	const char *unit, *type = NULL, *desc= "(no description)";
+	struct fit_verify v;
+	struct fit_data *fd;
 	const void *data;
 	int data_len;
 	int ret = 0;
-	struct device_node *conf_node = configuration;
 
-	if (conf_node) {
-		if (of_property_read_string(conf_node, name, &unit)) {
-			pr_err("No image named '%s'\n", name);
-			return -ENOENT;
-		}
+	image = fit_get_image(handle, configuration, name);
+	if (IS_ERR(image))
+		return PTR_ERR(image);
+
+	fit_print_image(image);
+
+	ret = fit_verify_init(handle, configuration, image, &v);
+	if (ret < 0)
+		return ret;
+
+	data = of_get_property(image, "data", &data_len);
+	if (data) {
+		fit_verify_update(&v, data, data_len);
 	} else {
-		unit = name;
+		fd = fit_find_data(handle, image);
+		if (!fd) {
+			pr_err("data not found\n");
+			ret = -EINVAL;
+			goto err;
+		}
+
+		if (fd->buf) {
+			fit_verify_update(&v, fd->buf, fd->size);
+		} else {
+			void *buf = malloc(fd->size);
+
+			if (!buf) {
+				ret = -ENOMEM;
+				goto err;
+			}
+
+			ret = fit_copy_image(handle, fd, NULL, buf, fd->size,
+					     &v);
+			if (ret) {
+				free(buf);
+				goto err;
+			}
+
+			fd->buf = buf;
+		}
+
+		data = fd->buf;
+		data_len = fd->size;
 	}
 
-	image = of_get_child_by_name(handle->images, unit);
-	if (!image)
-		return -ENOENT;
+	ret = fit_verify_final(&v);
+	if (ret < 0)
+		return ret;
 
-	of_property_read_string(image, "description", &desc);
-	pr_info("image '%s': '%s'\n", unit, desc);
+	*outdata = data;
+	*outsize = data_len;
 
-	of_property_read_string(image, "type", &type);
-	if (!type) {
-		pr_err("No \"type\" property found in %s\n", image->full_name);
+	return 0;
+err:
+	fit_verify_abort(&v);
+
+	return ret;
+}
+
+/**
+ * fit_get_image_size - get the size of an image in a FIT image
+ * @handle: The FIT image handle
+ * @configuration: The configuration cookie or NULL, see fit_open_image()
+ * @name: The name of the image
+ * @size: The size of the image
+ *
+ * Return: 0 for success, negative error code otherwise
+ */
+int fit_get_image_size(struct fit_handle *handle, void *configuration,
+		       const char *name, unsigned long *size)
+{
+	struct device_node *image;
+	struct fit_data *fd;
+	int data_len;
+
+	image = fit_get_image(handle, configuration, name);
+	if (IS_ERR(image))
+		return PTR_ERR(image);
+
+	if (of_get_property(image, "data", &data_len)) {
+		*size = data_len;
+		return 0;
+	}
+
+	fd = fit_find_data(handle, image);
+	if (!fd) {
+		pr_err("data not found\n");
 		return -EINVAL;
 	}
 
+	*size = fd->size;
+
+	return 0;
+}
+
+/**
+ * fit_load_image - load an image in a FIT image to a given location
+ * @handle: The FIT image handle
+ * @configuration: The configuration cookie or NULL, see fit_open_image()
+ * @name: The name of the image
+ * @dest: Where to load the image to
+ * @size: Size of the space at @dest
+ *
+ * Like fit_open_image(), but the image is placed at @dest. When the FIT
+ * image was opened from a file its data is read straight from the file to
+ * @dest without an intermediate copy. The image is verified while it is
+ * copied.
+ *
+ * Return: 0 for success, negative error code otherwise
+ */
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, void *dest, unsigned long size)
+{
+	struct device_node *image;
+	struct fit_verify v;
+	struct fit_data *fd = NULL;
+	const void *data;
+	int data_len, ret;
+
+	image = fit_get_image(handle, configuration, name);
+	if (IS_ERR(image))
+		return PTR_ERR(image);
+
+	fit_print_image(image);
+
 	data = of_get_property(image, "data", &data_len);
 	if (!data) {
-		pr_err("data not found\n");
-		return -EINVAL;
+		fd = fit_find_data(handle, image);
+		if (!fd) {
+			pr_err("data not found\n");
+			return -EINVAL;
+		}
+
+		data_len = fd->size;
 	}
 
-	if (conf_node)
-		ret = fit_verify_hash(handle, image, data, data_len);
-	else
-		ret = fit_image_verify_signature(handle, image, data, data_len);
+	if (data_len > size)
+		return -ENOSPC;
 
+	ret = fit_verify_init(handle, configuration, image, &v);
 	if (ret < 0)
 		return ret;
 
-	*outdata = data;
-	*outsize = data_len;
+	ret = fit_copy_image(handle, fd, data, dest, data_len, &v);
+	if (ret) {
+		fit_verify_abort(&v);
+		return ret;
+	}
 
-	return 0;
+	return fit_verify_final(&v);
 }
 
 static int fit_config_verify_signature(struct fit_handle *handle, struct device_node *conf_node)
@@ -743,6 +1041,8 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	handle->fit = buf;
 	handle->size = size;
 	handle->verify = verify;
+	handle->fd = -1;
+	INIT_LIST_HEAD(&handle->data_list);
 
 	ret = fit_do_open(handle);
 	if (ret) {
@@ -753,6 +1053,343 @@ struct fit_handle *fit_open_buf(const void *buf, size_t size, bool verbose,
 	return handle;
 }
 
+#define FIT_STREAM_BUFSIZE	4096
+
+struct fit_stream {
+	int fd;
+	loff_t pos;		/* file position of buf[0] */
+	int len;		/* valid bytes in buf */
+	int ofs;		/* read position in buf */
+	char buf[FIT_STREAM_BUFSIZE];
+};
+
+static loff_t fit_stream_tell(struct fit_stream *s)
+{
+	return s->pos + s->ofs;
+}
+
+static int fit_stream_seek(struct fit_stream *s, loff_t pos)
+{
+	if (pos >= s->pos && pos <= s->pos + s->len) {
+		s->ofs = pos - s->pos;
+		return 0;
+	}
+
+	/* Not seekable, fall back to reading the whole file */
+	if (lseek(s->fd, pos, SEEK_SET) != pos)
+		return -ESPIPE;
+
+	s->pos = pos;
+	s->len = s->ofs = 0;
+
+	return 0;
+}
+
+static int fit_stream_read(struct fit_stream *s, void *buf, int len)
+{
+	int now;
+
+	while (len) {
+		if (s->ofs == s->len) {
+			s->pos += s->len;
+			s->ofs = 0;
+			s->len = read(s->fd, s->buf, FIT_STREAM_BUFSIZE);
+			if (s->len < 0) {
+				s->len = 0;
+				return -errno;
+			}
+			if (!s->len)
+				return -EINVAL;
+		}
+
+		now = min(len, s->len - s->ofs);
+		memcpy(buf, s->buf + s->ofs, now);
+		s->ofs += now;
+		buf += now;
+		len -= now;
+	}
+
+	return 0;
+}
+
+struct fit_skel {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static void *fit_skel_add(struct fit_skel *sk, size_t len)
+{
+	void *p;
+
+	if (sk->len + len > sk->size) {
+		sk->size = max(sk->size * 2, sk->len + len);
+		sk->buf = xrealloc(sk->buf, sk->size);
+	}
+
+	p = sk->buf + sk->len;
+	sk->len += len;
+
+	return p;
+}
+
+/*
+ * Copy the structure block to @sk, leaving out the payload of the "data"
+ * properties of the images. Their position is added to handle->data_list.
+ */
+static int fit_stream_struct(struct fit_handle *handle, struct fit_stream *s,
+			     const struct fdt_header *f, const char *strings,
+			     struct fit_skel *sk)
+{
+	char path[FDT_MAX_PATH_LEN];
+	char *end = path;
+	loff_t struct_end = f->off_dt_struct + f->size_dt_struct;
+	int depth = -1;
+	uint32_t tag;
+	int ret;
+
+	*end = '\0';
+
+	do {
+		struct fdt_property prop;
+		struct fit_data *fd;
+		const char *name;
+		uint32_t *p;
+		char c;
+		int len;
+
+		if (fit_stream_tell(s) + FDT_TAGSIZE > struct_end)
+			return -EINVAL;
+
+		ret = fit_stream_read(s, &tag, FDT_TAGSIZE);
+		if (ret)
+			return ret;
+
+		switch (be32_to_cpu(tag)) {
+		case FDT_BEGIN_NODE:
+			if (++depth == FDT_MAX_DEPTH)
+				return -EINVAL;
+
+			p = fit_skel_add(sk, FDT_TAGSIZE);
+			*p = tag;
+
+			if (end != path + 1) {
+				if (end - path + 2 >= FDT_MAX_PATH_LEN)
+					return -EINVAL;
+				*end++ = '/';
+			}
+
+			len = 0;
+			do {
+				ret = fit_stream_read(s, &c, 1);
+				if (ret)
+					return ret;
+				*(char *)fit_skel_add(sk, 1) = c;
+				if (end - path + 1 >= FDT_MAX_PATH_LEN)
+					return -EINVAL;
+				*end++ = c;
+				len++;
+			} while (c);
+			end--;
+
+			len = ALIGN(len, 4) - len;
+			memset(fit_skel_add(sk, len), 0, len);
+			ret = fit_stream_seek(s, fit_stream_tell(s) + len);
+			if (ret)
+				return ret;
+
+			break;
+
+		case FDT_END_NODE:
+			if (depth-- < 0)
+				return -EINVAL;
+
+			p = fit_skel_add(sk, FDT_TAGSIZE);
+			*p = tag;
+
+			while (end > path && *--end != '/')
+				;
+			*end = '\0';
+
+			break;
+
+		case FDT_PROP:
+			ret = fit_stream_read(s, &prop.len, 2 * sizeof(uint32_t));
+			if (ret)
+				return ret;
+
+			len = be32_to_cpu(prop.len);
+			if (len < 0 || fit_stream_tell(s) + len > struct_end)
+				return -EINVAL;
+
+			if (be32_to_cpu(prop.nameoff) >= f->size_dt_strings)
+				return -EINVAL;
+			name = strings + be32_to_cpu(prop.nameoff);
+
+			if (depth == 2 && !strcmp(name, "data") &&
+			    !strncmp(path, "/images/", 8)) {
+				fd = xzalloc(sizeof(*fd));
+				fd->path = xstrdup(path);
+				fd->offset = fit_stream_tell(s);
+				fd->size = len;
+				list_add_tail(&fd->list, &handle->data_list);
+
+				ret = fit_stream_seek(s, fd->offset + ALIGN(len, 4));
+				if (ret)
+					return ret;
+				break;
+			}
+
+			prop.tag = tag;
+			memcpy(fit_skel_add(sk, sizeof(prop)), &prop, sizeof(prop));
+
+			len = ALIGN(len, 4);
+			ret = fit_stream_read(s, fit_skel_add(sk, len), len);
+			if (ret)
+				return ret;
+
+			break;
+
+		case FDT_NOP:
+		case FDT_END:
+			p = fit_skel_add(sk, FDT_TAGSIZE);
+			*p = tag;
+
+			break;
+
+		default:
+			pr_err("%s: Unknown tag 0x%08X\n", __func__,
+			       be32_to_cpu(tag));
+			return -EINVAL;
+		}
+	} while (be32_to_cpu(tag) != FDT_END);
+
+	return 0;
+}
+
+/*
+ * Read a FIT image from @filename without the image payloads, see struct
+ * fit_data. The result is a devicetree blob of its own which is used
+ * like a FIT image read completely.
+ */
+static int fit_open_stream(struct fit_handle *handle, const char *filename)
+{
+	struct fit_stream *s;
+	struct fdt_header hdr, f;
+	struct fdt_header *out;
+	struct fit_skel sk = {};
+	struct fit_data *fd, *tmp;
+	char *strings = NULL;
+	size_t hdr_size;
+	struct stat st;
+	int ret;
+
+	/*
+	 * Files on TFTP or HTTP can only be read front to back. For those
+	 * reading the whole file at once is the cheapest.
+	 */
+	ret = stat(filename, &st);
+	if (ret)
+		return -errno;
+	if (st.st_size == FILE_SIZE_STREAM)
+		return -ESPIPE;
+
+	s = xzalloc(sizeof(*s));
+
+	s->fd = open(filename, O_RDONLY);
+	if (s->fd < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	ret = fit_stream_read(s, &hdr, sizeof(hdr));
+	if (ret)
+		goto out;
+
+	f.magic = fdt32_to_cpu(hdr.magic);
+	f.totalsize = fdt32_to_cpu(hdr.totalsize);
+	f.off_dt_struct = fdt32_to_cpu(hdr.off_dt_struct);
+	f.size_dt_struct = fdt32_to_cpu(hdr.size_dt_struct);
+	f.off_dt_strings = fdt32_to_cpu(hdr.off_dt_strings);
+	f.size_dt_strings = fdt32_to_cpu(hdr.size_dt_strings);
+	f.version = fdt32_to_cpu(hdr.version);
+
+	/* The structure block size is only known since version 17 */
+	if (f.magic != FDT_MAGIC || f.version < 17) {
+		ret = -ESPIPE;
+		goto out;
+	}
+
+	if ((uint64_t)f.off_dt_struct + f.size_dt_struct > f.totalsize ||
+	    (uint64_t)f.off_dt_strings + f.size_dt_strings > f.totalsize) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	strings = xzalloc(f.size_dt_strings + 1);
+
+	ret = fit_stream_seek(s, f.off_dt_strings);
+	if (ret)
+		goto out;
+
+	ret = fit_stream_read(s, strings, f.size_dt_strings);
+	if (ret)
+		goto out;
+
+	ret = fit_stream_seek(s, f.off_dt_struct);
+	if (ret)
+		goto out;
+
+	/* header and an empty memory reservation map */
+	hdr_size = ALIGN(sizeof(hdr), 8) + sizeof(struct fdt_reserve_entry);
+	memset(fit_skel_add(&sk, hdr_size), 0, hdr_size);
+
+	ret = fit_stream_struct(handle, s, &f, strings, &sk);
+	if (ret)
+		goto out;
+
+	memcpy(fit_skel_add(&sk, f.size_dt_strings), strings,
+	       f.size_dt_strings);
+
+	out = (struct fdt_header *)sk.buf;
+	out->magic = cpu_to_fdt32(FDT_MAGIC);
+	out->totalsize = cpu_to_fdt32(sk.len);
+	out->off_mem_rsvmap = cpu_to_fdt32(ALIGN(sizeof(hdr), 8));
+	out->off_dt_struct = cpu_to_fdt32(hdr_size);
+	out->size_dt_struct = cpu_to_fdt32(sk.len - hdr_size -
+					   f.size_dt_strings);
+	out->off_dt_strings = cpu_to_fdt32(sk.len - f.size_dt_strings);
+	out->size_dt_strings = cpu_to_fdt32(f.size_dt_strings);
+	out->version = cpu_to_fdt32(17);
+	out->last_comp_version = cpu_to_fdt32(16);
+	out->boot_cpuid_phys = hdr.boot_cpuid_phys;
+
+	handle->fd = s->fd;
+	handle->fit_alloc = sk.buf;
+	handle->size = sk.len;
+
+	pr_debug("read %zu of %u bytes of %s\n", sk.len, f.totalsize, filename);
+
+	free(strings);
+	free(s);
+
+	return 0;
+out:
+	list_for_each_entry_safe(fd, tmp, &handle->data_list, list) {
+		list_del(&fd->list);
+		free(fd->path);
+		free(fd);
+	}
+
+	if (s->fd >= 0)
+		close(s->fd);
+	free(sk.buf);
+	free(strings);
+	free(s);
+
+	return ret;
+}
+
 /**
  * fit_open - open a FIT image
  * @filename:	The filename of the FIT image
@@ -774,11 +1411,16 @@ struct fit_handle *fit_open(const char *filename, bool verbose,
 
 	handle->verbose = verbose;
 	handle->verify = verify;
+	handle->fd = -1;
+	INIT_LIST_HEAD(&handle->data_list);
 
-	ret = read_file_2(filename, &handle->size, &handle->fit_alloc,
-			  FILESIZE_MAX);
+	ret = fit_open_stream(handle, filename);
+	if (ret == -ESPIPE)
+		ret = read_file_2(filename, &handle->size, &handle->fit_alloc,
+				  FILESIZE_MAX);
 	if (ret) {
 		pr_err("unable to read %s: %s\n", filename, strerror(-ret));
+		free(handle);
 		return ERR_PTR(ret);
 	}
 
@@ -795,9 +1437,20 @@ struct fit_handle *fit_open(const char *filename, bool verbose,
 
 void fit_close(struct fit_handle *handle)
 {
+	struct fit_data *fd, *tmp;
+
 	if (handle->root)
 		of_delete_node(handle->root);
 
+	list_for_each_entry_safe(fd, tmp, &handle->data_list, list) {
+		free(fd->buf);
+		free(fd->path);
+		free(fd);
+	}
+
+	if (handle->fd >= 0)
+		close(handle->fd);
+
 	free(handle->fit_alloc);
 	free(handle);
 }
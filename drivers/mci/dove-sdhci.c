@@ -33,8 +33,12 @@
 struct dove_sdhci {
 	struct mci_host mci;
 	void __iomem *base;
+	struct sdhci_adma2 adma;
+	bool use_adma;
 };
 
+#define DOVE_SDHCI_ADMA_DESCS	256
+
 #define priv_from_mci_host(h)	\
 	container_of(h, struct dove_sdhci, mci);
 
@@ -126,10 +130,22 @@ static int dove_sdhci_mci_send_cmd(struct mci_host *mci, struct mci_cmd *cmd,
 
 	/* setup transfer data */
 	if (data) {
+		u32 addr;
+
 		if (data->flags & MMC_DATA_READ)
-			dove_sdhci_writel(host, SDHCI_DMA_ADDRESS, (u32)data->dest);
+			addr = (u32)data->dest;
 		else
-			dove_sdhci_writel(host, SDHCI_DMA_ADDRESS, (u32)data->src);
+			addr = (u32)data->src;
+
+		if (host->use_adma) {
+			ret = sdhci_adma2_setup(&host->adma, addr, num_bytes);
+			if (ret)
+				return ret;
+			dove_sdhci_writel(host, SDHCI_ADMA_ADDRESS,
+					  host->adma.desc_dma);
+		} else {
+			dove_sdhci_writel(host, SDHCI_DMA_ADDRESS, addr);
+		}
 		dove_sdhci_writew(host, SDHCI_BLOCK_SIZE, SDHCI_DMA_BOUNDARY_512K |
 				SDHCI_TRANSFER_BLOCK_SIZE(data->blocksize));
 		dove_sdhci_writew(host, SDHCI_BLOCK_COUNT, data->blocks);
@@ -217,6 +233,11 @@ static int dove_sdhci_mci_send_cmd(struct mci_host *mci, struct mci_cmd *cmd,
 				dove_sdhci_readw(host, SDHCI_PRESENT_STATE1),
 				dove_sdhci_readw(host, SDHCI_INT_NORMAL_STATUS),
 				dove_sdhci_readw(host, SDHCI_INT_ERROR_STATUS));
+			if (dove_sdhci_readw(host, SDHCI_INT_ERROR_STATUS) &
+			    SDHCI_INT_ADMA_ERROR)
+				dev_err(host->mci.hw_dev, "ADMA error state %02x at 0x%08x\n",
+					dove_sdhci_readb(host, SDHCI_ADMA_ERROR),
+					dove_sdhci_readl(host, SDHCI_ADMA_ADDRESS));
 			goto cmd_error;
 		}
 	}
@@ -318,6 +339,14 @@ static int dove_sdhci_mci_init(struct mci_host *mci, struct device_d *dev)
 	dove_sdhci_writel(host, SDHCI_INT_ENABLE, ~0);
 	dove_sdhci_writel(host, SDHCI_SIGNAL_ENABLE, ~0);
 
+	if (host->use_adma) {
+		u8 val = dove_sdhci_readb(host, SDHCI_HOST_CONTROL);
+
+		val &= ~SDHCI_CTRL_DMA_MASK;
+		dove_sdhci_writeb(host, SDHCI_HOST_CONTROL,
+				  val | SDHCI_CTRL_ADMA32);
+	}
+
 	return 0;
 }
 
@@ -340,6 +369,18 @@ static void dove_sdhci_set_mci_caps(struct dove_sdhci *host)
 					MMC_CAP_MMC_HIGHSPEED |
 					MMC_CAP_SD_HIGHSPEED);
 
+	/*
+	 * With ADMA2 a whole multi block transfer is described by one
+	 * descriptor table, so let the core issue large requests
+	 */
+	if ((caps[1] & SDHCI_HOSTCAP_ADMA2) &&
+	    !sdhci_adma2_alloc(&host->adma, DOVE_SDHCI_ADMA_DESCS)) {
+		host->use_adma = true;
+		host->mci.max_req_size = sdhci_adma2_max_req_size(&host->adma);
+	}
+
+	host->mci.host_caps |= MMC_CAP_CMD23;
+
 	/* parse board supported bus width capabilities */
 	mci_of_parse(&host->mci);
 
@@ -596,6 +596,8 @@ static int dw_mmc_probe(struct device_d *dev)
 	host->mci.host_caps = MMC_CAP_4_BIT_DATA | MMC_CAP_8_BIT_DATA;
 	host->mci.host_caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_MMC_HIGHSPEED_52MHZ |
 			       MMC_CAP_SD_HIGHSPEED;
+	/* dwmci_prepare_data_dma() takes at most one block per descriptor */
+	host->mci.max_req_size = DW_MMC_NUM_IDMACS * 512;
 
 	if (pdata) {
 		host->ciu_div = pdata->ciu_div;
@@ -687,6 +687,14 @@ static int fsl_esdhc_probe(struct device_d *dev)
 	if (caps & ESDHC_HOSTCAPBLT_HSS)
 		mci->host_caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED;
 
+	/*
+	 * Controllers which need the stop command flagged as abort rely on
+	 * CMD12 ending every multi block transfer, keep them on open ended
+	 * transfers
+	 */
+	if (!(host->socdata->flags & ESDHC_FLAG_MULTIBLK_NO_INT))
+		mci->host_caps |= MMC_CAP_CMD23;
+
 	host->mci.send_cmd = esdhc_send_cmd;
 	host->mci.set_ios = esdhc_set_ios;
 	host->mci.init = esdhc_init;
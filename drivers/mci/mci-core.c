@@ -38,6 +38,8 @@
 #include <linux/err.h>
 
 #define MAX_BUFFER_NUMBER 0xffffffff
+/* SDHCI style hosts only have a 16 bit block count register */
+#define MAX_BLOCK_COUNT 0xffff
 
 #define UNSTUFF_BITS(resp,start,size)					\
 	({								\
@@ -133,6 +135,25 @@ static int mci_set_blocklen(struct mci *mci, unsigned len)
 
 static void *sector_buf;
 
+/**
+ * Announce the length of the following multiple block transfer (CMD23)
+ * @param mci MCI instance
+ * @param blocks Block count of the following transfer
+ * @return true if the card stops the transfer on its own, so that no
+ * CMD12 has to be sent afterwards
+ */
+static bool mci_set_block_count(struct mci *mci, int blocks)
+{
+	struct mci_cmd cmd;
+
+	if (blocks <= 1 || !(mci_caps(mci) & MMC_CAP_CMD23))
+		return false;
+
+	mci_setup_cmd(&cmd, MMC_CMD_SET_BLOCK_COUNT, blocks, MMC_RSP_R1);
+
+	return mci_send_cmd(mci, &cmd, NULL) == 0;
+}
+
 /**
  * Write one or several blocks of data to the card
  * @param mci_dev MCI instance
@@ -149,6 +170,7 @@ static int mci_block_write(struct mci *mci, const void *src, int blocknum,
 	const void *buf;
 	unsigned mmccmd;
 	int ret;
+	bool predefined;
 
 	if (blocks > 1)
 		mmccmd = MMC_CMD_WRITE_MULTIPLE_BLOCK;
@@ -172,9 +194,11 @@ static int mci_block_write(struct mci *mci, const void *src, int blocknum,
 	data.blocksize = mci->write_bl_len;
 	data.flags = MMC_DATA_WRITE;
 
+	predefined = mci_set_block_count(mci, blocks);
+
 	ret = mci_send_cmd(mci, &cmd, &data);
 
-	if (ret || blocks > 1) {
+	if (ret || (blocks > 1 && !predefined)) {
 		mci_setup_cmd(&cmd, MMC_CMD_STOP_TRANSMISSION, 0, MMC_RSP_R1b);
 		mci_send_cmd(mci, &cmd, NULL);
         }
@@ -196,6 +220,7 @@ static int mci_read_block(struct mci *mci, void *dst, int blocknum,
 	struct mci_data data;
 	int ret;
 	unsigned mmccmd;
+	bool predefined;
 
 	if (blocks > 1)
 		mmccmd = MMC_CMD_READ_MULTIPLE_BLOCK;
@@ -212,9 +237,11 @@ static int mci_read_block(struct mci *mci, void *dst, int blocknum,
 	data.blocksize = mci->read_bl_len;
 	data.flags = MMC_DATA_READ;
 
+	predefined = mci_set_block_count(mci, blocks);
+
 	ret = mci_send_cmd(mci, &cmd, &data);
 
-	if (ret || blocks > 1) {
+	if (ret || (blocks > 1 && !predefined)) {
 		mci_setup_cmd(&cmd, MMC_CMD_STOP_TRANSMISSION, 0, MMC_RSP_R1b);
 		mci_send_cmd(mci, &cmd, NULL);
 	}
@@ -246,6 +273,66 @@ static int mci_go_idle(struct mci *mci)
 	return 0;
 }
 
+static bool sd_uhs_possible(struct mci_host *host)
+{
+	return (host->host_caps & MMC_CAP_UHS_MASK) &&
+		host->set_signal_voltage && !mmc_host_is_spi(host);
+}
+
+/**
+ * Switch the I/O lines between 3.3V and 1.8V
+ * @param mci MCI instance
+ * @param voltage MMC_SIGNAL_VOLTAGE_*
+ * @return 0 on success
+ */
+static int mci_set_signal_voltage(struct mci *mci, unsigned voltage)
+{
+	struct mci_host *host = mci->host;
+	int err;
+
+	if (host->signal_voltage == voltage)
+		return 0;
+
+	if (!host->set_signal_voltage)
+		return -ENOSYS;
+
+	err = host->set_signal_voltage(host, voltage);
+	if (err)
+		return err;
+
+	host->signal_voltage = voltage;
+
+	return 0;
+}
+
+/**
+ * Switch a SD card which accepted S18R to 1.8V signalling
+ * @param mci MCI instance
+ * @return Transaction status (0 on success)
+ *
+ * A card which rejects CMD11 stays at 3.3V and is used without UHS-I
+ * modes. Once the card accepted the command it is only usable after the
+ * host switched as well.
+ */
+static int sd_switch_signal_voltage(struct mci *mci)
+{
+	struct mci_cmd cmd;
+	int err;
+
+	mci_setup_cmd(&cmd, SD_CMD_SWITCH_UHS18V, 0, MMC_RSP_R1);
+	err = mci_send_cmd(mci, &cmd, NULL);
+	if (err) {
+		dev_dbg(&mci->dev, "Card refuses to switch to 1.8V: %d\n", err);
+		return 0;
+	}
+
+	err = mci_set_signal_voltage(mci, MMC_SIGNAL_VOLTAGE_180);
+	if (err)
+		dev_err(&mci->dev, "Switching to 1.8V signalling failed: %d\n", err);
+
+	return err;
+}
+
 /**
  * FIXME
  * @param mci MCI instance
@@ -280,8 +367,11 @@ static int sd_send_op_cond(struct mci *mci)
 
 		arg = mmc_host_is_spi(host) ? 0 : voltages;
 
-		if (mci->version == SD_VERSION_2)
+		if (mci->version == SD_VERSION_2) {
 			arg |= OCR_HCS;
+			if (sd_uhs_possible(host))
+				arg |= OCR_S18R;
+		}
 
 		mci_setup_cmd(&cmd, SD_CMD_APP_SEND_OP_COND, arg, MMC_RSP_R3);
 		err = mci_send_cmd(mci, &cmd, NULL);
@@ -318,6 +408,9 @@ static int sd_send_op_cond(struct mci *mci)
 	mci->high_capacity = ((mci->ocr & OCR_HCS) == OCR_HCS);
 	mci->rca = 0;
 
+	if ((arg & OCR_S18R) && (mci->ocr & OCR_S18R))
+		return sd_switch_signal_voltage(mci);
+
 	return 0;
 }
 
@@ -409,6 +502,81 @@ int mci_switch(struct mci *mci, unsigned index, unsigned value)
 	return mci_send_cmd(mci, &cmd, NULL);
 }
 
+static const u8 tuning_blk_pattern_4bit[] = {
+	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
+	0xc3, 0x3c, 0xcc, 0xff, 0xfe, 0xff, 0xfe, 0xef,
+	0xff, 0xdf, 0xff, 0xdd, 0xff, 0xfb, 0xff, 0xfb,
+	0xbf, 0xff, 0x7f, 0xff, 0x77, 0xf7, 0xbd, 0xef,
+	0xff, 0xf0, 0xff, 0xf0, 0x0f, 0xfc, 0xcc, 0x3c,
+	0xcc, 0x33, 0xcc, 0xcf, 0xff, 0xef, 0xff, 0xee,
+	0xff, 0xfd, 0xff, 0xfd, 0xdf, 0xff, 0xbf, 0xff,
+	0xbb, 0xff, 0xf7, 0xff, 0xf7, 0x7f, 0x7b, 0xde,
+};
+
+static const u8 tuning_blk_pattern_8bit[] = {
+	0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00,
+	0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc, 0xcc,
+	0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff, 0xff,
+	0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee, 0xff,
+	0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd, 0xdd,
+	0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb,
+	0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff, 0xff,
+	0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee, 0xff,
+	0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+	0x00, 0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc,
+	0xcc, 0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff,
+	0xff, 0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee,
+	0xff, 0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd,
+	0xdd, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff,
+	0xbb, 0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff,
+	0xff, 0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee,
+};
+
+/**
+ * Read the tuning block and compare it against the expected pattern
+ * @param host MCI host
+ * @param opcode MMC_CMD_SEND_TUNING_BLOCK(_HS200)
+ * @return 0 if the block was read correctly
+ *
+ * Meant to be called by the execute_tuning() implementation of host drivers
+ * for every sample point they probe.
+ */
+int mci_send_tuning(struct mci_host *host, u32 opcode)
+{
+	struct mci *mci = host->mci;
+	struct mci_cmd cmd;
+	struct mci_data data;
+	const u8 *pattern;
+	unsigned size;
+	int err;
+
+	if (host->bus_width == MMC_BUS_WIDTH_8) {
+		pattern = tuning_blk_pattern_8bit;
+		size = sizeof(tuning_blk_pattern_8bit);
+	} else if (host->bus_width == MMC_BUS_WIDTH_4) {
+		pattern = tuning_blk_pattern_4bit;
+		size = sizeof(tuning_blk_pattern_4bit);
+	} else {
+		return -EINVAL;
+	}
+
+	mci_setup_cmd(&cmd, opcode, 0, MMC_RSP_R1);
+
+	data.dest = sector_buf;
+	data.blocks = 1;
+	data.blocksize = size;
+	data.flags = MMC_DATA_READ;
+
+	err = mci_send_cmd(mci, &cmd, &data);
+	if (err)
+		return err;
+
+	if (memcmp(sector_buf, pattern, size))
+		return -EIO;
+
+	return 0;
+}
+
 static int mci_calc_blk_cnt(uint64_t cap, unsigned shift)
 {
 	unsigned ret = cap >> shift;
@@ -456,6 +624,10 @@ static int mmc_change_freq(struct mci *mci)
 	mci->ext_csd = xmalloc(512);
 	mci->card_caps = 0;
 
+	/* SET_BLOCK_COUNT was introduced with MMC 3.1 */
+	if (mci->version >= MMC_VERSION_3)
+		mci->card_caps |= MMC_CAP_CMD23;
+
 	/* Only version 4 supports high-speed */
 	if (mci->version < MMC_VERSION_4)
 		return 0;
@@ -497,6 +669,12 @@ static int mmc_change_freq(struct mci *mci)
 	else
 		mci->card_caps |= MMC_CAP_MMC_HIGHSPEED;
 
+	/* HS200 and HS400 get selected after the bus width is known */
+	if (cardtype & EXT_CSD_CARD_TYPE_SDR_1_8V)
+		mci->card_caps |= MMC_CAP_MMC_HS200;
+	if (cardtype & EXT_CSD_CARD_TYPE_HS400_1_8V)
+		mci->card_caps |= MMC_CAP_MMC_HS400;
+
 	if (IS_ENABLED(CONFIG_MCI_MMC_BOOT_PARTITIONS) &&
 			mci->ext_csd[EXT_CSD_REV] >= 3 && mci->ext_csd[EXT_CSD_BOOT_SIZE_MULT]) {
 		int idx;
@@ -623,6 +801,8 @@ retry_scr:
 
 	if (mci->scr[0] & SD_DATA_4BIT)
 		mci->card_caps |= MMC_CAP_4_BIT_DATA;
+	if (mci->scr[0] & SD_SCR_CMD23_SUPPORT)
+		mci->card_caps |= MMC_CAP_CMD23;
 
 	/* Version 1.0 doesn't support switching */
 	if (mci->version == SD_VERSION_1_0)
@@ -642,6 +822,18 @@ retry_scr:
 			break;
 	}
 
+	/* UHS-I modes are only available with 1.8V signalling */
+	if (host->signal_voltage == MMC_SIGNAL_VOLTAGE_180) {
+		unsigned modes = (__be32_to_cpu(switch_status[3]) >> 16) & 0xff;
+
+		if (modes & SD_MODE_UHS_SDR50)
+			mci->card_caps |= MMC_CAP_UHS_SDR50;
+		if (modes & SD_MODE_UHS_SDR104)
+			mci->card_caps |= MMC_CAP_UHS_SDR104;
+		if (modes & SD_MODE_UHS_DDR50)
+			mci->card_caps |= MMC_CAP_UHS_DDR50;
+	}
+
 	/* If high-speed isn't supported, we return */
 	if (!(__be32_to_cpu(switch_status[3]) & SD_HIGHSPEED_SUPPORTED))
 		return 0;
@@ -672,6 +864,7 @@ static void mci_set_ios(struct mci *mci)
 
 	ios.bus_width = host->bus_width;
 	ios.clock = host->clock;
+	ios.timing = host->timing;
 
 	host->set_ios(host, &ios);
 }
@@ -696,6 +889,40 @@ static void mci_set_clock(struct mci *mci, unsigned clock)
 	mci_set_ios(mci);
 }
 
+/**
+ * Setup host's interface timing
+ * @param mci MCI instance
+ * @param timing New timing specification (refer MMC_TIMING_*)
+ */
+static void mci_set_timing(struct mci *mci, unsigned timing)
+{
+	struct mci_host *host = mci->host;
+
+	host->timing = timing;	/* the new target timing */
+	mci_set_ios(mci);
+}
+
+/**
+ * Let the host find the sample point for the current timing
+ * @param mci MCI instance
+ * @param opcode Tuning command the card understands in this mode
+ * @return 0 on success, -ENOSYS if the host cannot tune
+ */
+static int mci_execute_tuning(struct mci *mci, u32 opcode)
+{
+	struct mci_host *host = mci->host;
+	int err;
+
+	if (!host->execute_tuning)
+		return -ENOSYS;
+
+	err = host->execute_tuning(host, opcode);
+	if (err)
+		dev_dbg(&mci->dev, "Tuning failed: %d\n", err);
+
+	return err;
+}
+
 /**
  * Setup host's interface bus width
  * @param mci MCI instance
@@ -971,6 +1198,82 @@ static char *mci_version_string(struct mci *mci)
 	return version;
 }
 
+static const struct sd_uhs_mode {
+	unsigned cap;
+	unsigned bus_speed;
+	unsigned timing;
+	unsigned clock;
+	bool tuning;
+} sd_uhs_modes[] = {
+	{
+		.cap = MMC_CAP_UHS_SDR104,
+		.bus_speed = UHS_SDR104_BUS_SPEED,
+		.timing = MMC_TIMING_UHS_SDR104,
+		.clock = 208000000,
+		.tuning = true,
+	}, {
+		.cap = MMC_CAP_UHS_DDR50,
+		.bus_speed = UHS_DDR50_BUS_SPEED,
+		.timing = MMC_TIMING_UHS_DDR50,
+		.clock = 50000000,
+	}, {
+		.cap = MMC_CAP_UHS_SDR50,
+		.bus_speed = UHS_SDR50_BUS_SPEED,
+		.timing = MMC_TIMING_UHS_SDR50,
+		.clock = 100000000,
+		.tuning = true,
+	},
+};
+
+/**
+ * Switch the card to the fastest UHS-I mode both sides support
+ * @param mci MCI instance
+ * @return 0 on success
+ *
+ * Starting from SDR104 each mode is tried in turn. A mode whose switch or
+ * tuning fails makes us step back to SDR25 before the next one is tried. If
+ * no mode works the card is left in SDR25, which it was in before.
+ */
+static int sd_select_uhs(struct mci *mci)
+{
+	uint32_t *switch_status = sector_buf;
+	int i, err;
+
+	for (i = 0; i < ARRAY_SIZE(sd_uhs_modes); i++) {
+		const struct sd_uhs_mode *mode = &sd_uhs_modes[i];
+
+		if (!(mci_caps(mci) & mode->cap))
+			continue;
+
+		err = sd_switch(mci, SD_SWITCH_SWITCH, 0, mode->bus_speed,
+				(uint8_t *)switch_status);
+		if (err)
+			return err;
+
+		if (((__be32_to_cpu(switch_status[4]) >> 24) & 0xf) !=
+				mode->bus_speed)
+			continue;
+
+		mci_set_timing(mci, mode->timing);
+		mci_set_clock(mci, mode->clock);
+
+		if (!mode->tuning ||
+		    !mci_execute_tuning(mci, MMC_CMD_SEND_TUNING_BLOCK)) {
+			mci->tran_speed = mode->clock;
+			return 0;
+		}
+
+		dev_dbg(&mci->dev, "UHS-I mode %u unusable, stepping down\n",
+			mode->bus_speed);
+
+		mci_set_timing(mci, MMC_TIMING_UHS_SDR25);
+		mci_set_clock(mci, mci->tran_speed);
+	}
+
+	return sd_switch(mci, SD_SWITCH_SWITCH, 0, UHS_SDR25_BUS_SPEED,
+			 (uint8_t *)switch_status);
+}
+
 static int mci_startup_sd(struct mci *mci)
 {
 	struct mci_cmd cmd;
@@ -996,11 +1299,148 @@ static int mci_startup_sd(struct mci *mci)
 		mci_set_bus_width(mci, MMC_BUS_WIDTH_4);
 	}
 
+	if (mci_caps(mci) & MMC_CAP_SD_HIGHSPEED)
+		mci->host->timing = MMC_TIMING_SD_HS;
+
+	mci_set_clock(mci, mci->tran_speed);
+
+	/* UHS-I modes are defined for the 4 bit bus only */
+	if ((mci_caps(mci) & MMC_CAP_UHS_MASK) &&
+	    mci->host->bus_width == MMC_BUS_WIDTH_4)
+		return sd_select_uhs(mci);
+
+	return 0;
+}
+
+/**
+ * Switch a MMC card from HS200 or HS400 back to high speed
+ * @param mci MCI instance
+ * @return Transaction status (0 on success)
+ */
+static int mmc_select_hs(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+	int err;
+
+	if (mci->card_caps & MMC_CAP_MMC_HIGHSPEED_52MHZ)
+		mci->tran_speed = 52000000;
+	else
+		mci->tran_speed = 26000000;
+
+	mci_set_timing(mci, MMC_TIMING_MMC_HS);
 	mci_set_clock(mci, mci->tran_speed);
 
+	err = mci_switch(mci, EXT_CSD_HS_TIMING, EXT_CSD_TIMING_HS);
+	if (err)
+		return err;
+
+	return mci_switch(mci, EXT_CSD_BUS_WIDTH,
+			  host->bus_width == MMC_BUS_WIDTH_8 ?
+			  EXT_CSD_BUS_WIDTH_8 : EXT_CSD_BUS_WIDTH_4);
+}
+
+/**
+ * Switch a MMC card to HS200 and tune the host
+ * @param mci MCI instance
+ * @return Transaction status (0 on success)
+ *
+ * The bus width must already be set up.
+ */
+static int mmc_select_hs200(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+	int err;
+
+	/* Without a callback the board is expected to have VCCQ at 1.8V */
+	if (host->set_signal_voltage) {
+		err = mci_set_signal_voltage(mci, MMC_SIGNAL_VOLTAGE_180);
+		if (err)
+			return err;
+	}
+
+	err = mci_switch(mci, EXT_CSD_HS_TIMING, EXT_CSD_TIMING_HS200);
+	if (err)
+		return err;
+
+	mci_set_timing(mci, MMC_TIMING_MMC_HS200);
+	mci_set_clock(mci, 200000000);
+
+	err = mci_execute_tuning(mci, MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	if (err)
+		return err;
+
+	mci->tran_speed = 200000000;
+
 	return 0;
 }
 
+/**
+ * Switch a MMC card from tuned HS200 to HS400
+ * @param mci MCI instance
+ * @return Transaction status (0 on success)
+ *
+ * HS400 has no tuning of its own, it uses the sample point found in HS200.
+ * The switch has to go through high speed timing at 52MHz.
+ */
+static int mmc_select_hs400(struct mci *mci)
+{
+	int err;
+
+	mci_set_timing(mci, MMC_TIMING_MMC_HS);
+	mci_set_clock(mci, 52000000);
+
+	err = mci_switch(mci, EXT_CSD_HS_TIMING, EXT_CSD_TIMING_HS);
+	if (err)
+		return err;
+
+	err = mci_switch(mci, EXT_CSD_BUS_WIDTH, EXT_CSD_DDR_BUS_WIDTH_8);
+	if (err)
+		return err;
+
+	err = mci_switch(mci, EXT_CSD_HS_TIMING, EXT_CSD_TIMING_HS400);
+	if (err)
+		return err;
+
+	mci_set_timing(mci, MMC_TIMING_MMC_HS400);
+	mci_set_clock(mci, 200000000);
+
+	mci->tran_speed = 200000000;
+
+	return 0;
+}
+
+/**
+ * Select the fastest of HS400, HS200 and high speed that works
+ * @param mci MCI instance
+ * @return Transaction status (0 on success)
+ */
+static int mmc_select_timing(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+	int err;
+
+	err = mmc_select_hs200(mci);
+	if (!err && (mci_caps(mci) & MMC_CAP_MMC_HS400) &&
+	    host->bus_width == MMC_BUS_WIDTH_8) {
+		err = mmc_select_hs400(mci);
+		if (!err)
+			return 0;
+
+		dev_warn(&mci->dev, "Switching to HS400 failed: %d\n", err);
+
+		err = mci_switch(mci, EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_8);
+		if (!err)
+			err = mmc_select_hs200(mci);
+	}
+
+	if (!err)
+		return 0;
+
+	dev_warn(&mci->dev, "Switching to HS200 failed: %d\n", err);
+
+	return mmc_select_hs(mci);
+}
+
 static int mci_startup_mmc(struct mci *mci)
 {
 	struct mci_host *host = mci->host;
@@ -1021,6 +1461,8 @@ static int mci_startup_mmc(struct mci *mci)
 			mci->tran_speed = 52000000;
 		else
 			mci->tran_speed = 26000000;
+
+		host->timing = MMC_TIMING_MMC_HS;
 	}
 
 	mci_set_clock(mci, mci->tran_speed);
@@ -1057,7 +1499,18 @@ static int mci_startup_mmc(struct mci *mci)
 			break;
 	}
 
-	return err;
+	if (err)
+		return err;
+
+	/*
+	 * HS200 and HS400 cannot be used without tuning. Hosts which cannot
+	 * tune keep the card in high speed mode, which is set up already.
+	 */
+	if ((mci_caps(mci) & MMC_CAP_MMC_HS200) && host->execute_tuning &&
+	    host->bus_width != MMC_BUS_WIDTH_1)
+		return mmc_select_timing(mci);
+
+	return 0;
 }
 
 /**
@@ -1339,7 +1792,7 @@ static int mci_sd_read(struct block_device *blk, void *buffer, int block,
 {
 	struct mci_part *part = container_of(blk, struct mci_part, blk);
 	struct mci *mci = part->mci;
-	unsigned max_req_block = num_blocks;
+	unsigned max_req_block = MAX_BLOCK_COUNT;
 	int read_block;
 	int rc;
 
@@ -1472,12 +1925,17 @@ static unsigned extract_mtd_year(struct mci *mci)
 
 static void mci_print_caps(unsigned caps)
 {
-	printf("  capabilities: %s%s%s%s%s\n",
+	printf("  capabilities: %s%s%s%s%s%s%s%s%s%s\n",
 		caps & MMC_CAP_4_BIT_DATA ? "4bit " : "",
 		caps & MMC_CAP_8_BIT_DATA ? "8bit " : "",
 		caps & MMC_CAP_SD_HIGHSPEED ? "sd-hs " : "",
 		caps & MMC_CAP_MMC_HIGHSPEED ? "mmc-hs " : "",
-		caps & MMC_CAP_MMC_HIGHSPEED_52MHZ ? "mmc-52MHz " : "");
+		caps & MMC_CAP_MMC_HIGHSPEED_52MHZ ? "mmc-52MHz " : "",
+		caps & MMC_CAP_MMC_HS200 ? "mmc-hs200 " : "",
+		caps & MMC_CAP_MMC_HS400 ? "mmc-hs400 " : "",
+		caps & MMC_CAP_UHS_SDR50 ? "sd-uhs-sdr50 " : "",
+		caps & MMC_CAP_UHS_SDR104 ? "sd-uhs-sdr104 " : "",
+		caps & MMC_CAP_UHS_DDR50 ? "sd-uhs-ddr50 " : "");
 }
 
 /**
@@ -1669,6 +2127,11 @@ static int mci_card_probe(struct mci *mci)
 		goto on_error;
 	}
 
+	/* a previous probe may have left the host in a faster mode */
+	host->timing = MMC_TIMING_LEGACY;
+	if (host->set_signal_voltage)
+		mci_set_signal_voltage(mci, MMC_SIGNAL_VOLTAGE_330);
+
 	mci_set_bus_width(mci, MMC_BUS_WIDTH_1);
 	/* according to the SD card spec the detection can happen at 400 kHz */
 	mci_set_clock(mci, 400000);
@@ -1913,6 +2376,17 @@ void mci_of_parse_node(struct mci_host *host,
 
 	host->non_removable = of_property_read_bool(np, "non-removable");
 	host->no_sd = of_property_read_bool(np, "no-sd");
+
+	if (of_property_read_bool(np, "sd-uhs-sdr50"))
+		host->host_caps |= MMC_CAP_UHS_SDR50;
+	if (of_property_read_bool(np, "sd-uhs-sdr104"))
+		host->host_caps |= MMC_CAP_UHS_SDR104;
+	if (of_property_read_bool(np, "sd-uhs-ddr50"))
+		host->host_caps |= MMC_CAP_UHS_DDR50;
+	if (of_property_read_bool(np, "mmc-hs200-1_8v"))
+		host->host_caps |= MMC_CAP_MMC_HS200;
+	if (of_property_read_bool(np, "mmc-hs400-1_8v"))
+		host->host_caps |= MMC_CAP_MMC_HS200 | MMC_CAP_MMC_HS400;
 }
 
 void mci_of_parse(struct mci_host *host)
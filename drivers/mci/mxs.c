@@ -587,6 +587,11 @@ static int mxs_mci_probe(struct device_d *hw_dev)
 
 	if (host->f_min < 400000)
 		host->f_min = 400000;
+
+#ifdef CONFIG_ARCH_IMX23
+	/* 16 bit byte count in CTRL0, 8 bit block count in CMD0 */
+	host->max_req_size = 0xffff & ~511;
+#endif
 	if (host->f_max == 0)
 		host->f_max = rate / 2 / 1;
 
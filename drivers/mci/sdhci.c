@@ -0,0 +1,78 @@
+/*
+ * Helpers shared by the SDHCI compatible MCI host drivers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <common.h>
+#include <dma.h>
+
+#include "sdhci.h"
+
+/**
+ * sdhci_adma2_alloc - allocate an ADMA2 descriptor table
+ * @adma: the descriptor table
+ * @num_desc: number of descriptors
+ *
+ * A transfer can be at most num_desc * SDHCI_ADMA2_DESC_LEN bytes long,
+ * see sdhci_adma2_max_req_size().
+ */
+int sdhci_adma2_alloc(struct sdhci_adma2 *adma, int num_desc)
+{
+	adma->desc = dma_alloc_coherent(num_desc * sizeof(*adma->desc),
+					&adma->desc_dma);
+	if (!adma->desc)
+		return -ENOMEM;
+
+	adma->num_desc = num_desc;
+
+	return 0;
+}
+
+/**
+ * sdhci_adma2_setup - describe a physically contiguous buffer
+ * @adma: the descriptor table
+ * @addr: DMA address of the buffer
+ * @len: length of the buffer in bytes
+ *
+ * The caller has to write adma->desc_dma to the ADMA system address
+ * register and select ADMA2 in the host control register.
+ */
+int sdhci_adma2_setup(struct sdhci_adma2 *adma, dma_addr_t addr,
+		      unsigned int len)
+{
+	struct sdhci_adma2_desc *desc = adma->desc;
+	int i = 0;
+
+	if (len > sdhci_adma2_max_req_size(adma))
+		return -EINVAL;
+
+	while (len) {
+		unsigned int now = min_t(unsigned int, len,
+					 SDHCI_ADMA2_DESC_LEN);
+
+		desc[i].attr = cpu_to_le16(ADMA2_TRAN | ADMA2_VALID);
+		desc[i].len = cpu_to_le16(now);
+		desc[i].addr = cpu_to_le32(addr);
+
+		addr += now;
+		len -= now;
+		i++;
+	}
+
+	if (!i)
+		return -EINVAL;
+
+	desc[i - 1].attr |= cpu_to_le16(ADMA2_END);
+
+	return 0;
+}
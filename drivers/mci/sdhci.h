@@ -43,6 +43,8 @@
 #define SDHCI_HOST_CONTROL__POWER_CONTROL__BLOCK_GAP_CONTROL	0x28
 #define SDHCI_HOST_CONTROL					0x28
 #define  SDHCI_DATA_WIDTH_8BIT			BIT(5)
+#define  SDHCI_CTRL_DMA_MASK			(3 << 3)
+#define  SDHCI_CTRL_ADMA32			(2 << 3)
 #define  SDHCI_HIGHSPEED_EN			BIT(2)
 #define  SDHCI_DATA_WIDTH_4BIT			BIT(1)
 #define SDHCI_POWER_CONTROL					0x29
@@ -65,6 +67,7 @@
 #define  SDHCI_INT_XFER_COMPLETE		BIT(1)
 #define  SDHCI_INT_CMD_COMPLETE			BIT(0)
 #define SDHCI_INT_ERROR_STATUS					0x32
+#define  SDHCI_INT_ADMA_ERROR			BIT(9)
 #define SDHCI_INT_ENABLE					0x34
 #define SDHCI_SIGNAL_ENABLE					0x38
 #define SDHCI_ACMD12_ERR__HOST_CONTROL2				0x3C
@@ -74,8 +77,12 @@
 #define  SDHCI_HOSTCAP_VOLTAGE_300		BIT(9)
 #define  SDHCI_HOSTCAP_VOLTAGE_330		BIT(8)
 #define  SDHCI_HOSTCAP_HIGHSPEED		BIT(5)
+#define  SDHCI_HOSTCAP_ADMA2			BIT(3)
 #define  SDHCI_HOSTCAP_8BIT			BIT(2)
 
+#define SDHCI_ADMA_ERROR					0x54
+#define SDHCI_ADMA_ADDRESS					0x58
+
 #define SDHCI_SPEC_200_MAX_CLK_DIVIDER	256
 #define SDHCI_MMC_BOOT						0xC4
 
@@ -149,4 +156,33 @@
 #define PRSSTAT_CIDHB		0x00000002
 #define PRSSTAT_CICHB		0x00000001
 
+/* 32 bit ADMA2 descriptor */
+struct sdhci_adma2_desc {
+	__le16 attr;
+	__le16 len;
+	__le32 addr;
+} __packed;
+
+#define ADMA2_VALID		BIT(0)
+#define ADMA2_END		BIT(1)
+#define ADMA2_TRAN		(2 << 4)
+
+/* bytes per descriptor, kept below the 64 KiB limit of the length field */
+#define SDHCI_ADMA2_DESC_LEN	0x8000
+
+struct sdhci_adma2 {
+	struct sdhci_adma2_desc *desc;
+	dma_addr_t desc_dma;
+	int num_desc;
+};
+
+int sdhci_adma2_alloc(struct sdhci_adma2 *adma, int num_desc);
+int sdhci_adma2_setup(struct sdhci_adma2 *adma, dma_addr_t addr,
+		      unsigned int len);
+
+static inline unsigned int sdhci_adma2_max_req_size(struct sdhci_adma2 *adma)
+{
+	return adma->num_desc * SDHCI_ADMA2_DESC_LEN;
+}
+
 #endif /* __MCI_SDHCI_H */
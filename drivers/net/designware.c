@@ -291,6 +291,8 @@ static int dwc_ether_send(struct eth_device *dev, void *packet, int length)
 
 	if (priv->enh_desc) {
 		desc_p->txrx_status |= DESC_ENH_TXSTS_TXFIRST | DESC_ENH_TXSTS_TXLAST;
+		if (priv->tx_coe)
+			desc_p->txrx_status |= DESC_ENH_TXSTS_TXCHECKINSCTRL;
 		desc_p->dmamac_cntl &= ~(DESC_ENH_TXCTRL_SIZE1MASK);
 		desc_p->dmamac_cntl |= (length << DESC_ENH_TXCTRL_SIZE1SHFT) &
 				       DESC_ENH_TXCTRL_SIZE1MASK;
@@ -302,6 +304,8 @@ static int dwc_ether_send(struct eth_device *dev, void *packet, int length)
 		desc_p->dmamac_cntl |= ((length << DESC_TXCTRL_SIZE1SHFT) &
 				       DESC_TXCTRL_SIZE1MASK) | DESC_TXCTRL_TXLAST |
 				       DESC_TXCTRL_TXFIRST;
+		if (priv->tx_coe)
+			desc_p->dmamac_cntl |= DESC_TXCTRL_TXCHECKINSCTRL;
 
 		desc_p->txrx_status = DESC_TXSTS_OWNBYDMA;
 	}
@@ -353,7 +357,8 @@ static int dwc_ether_rx(struct eth_device *dev)
 				   DESC_RXSTS_RXWATCHDOG |
 				   DESC_RXSTS_RXMIIERROR |
 				   DESC_RXSTS_RXCRC));
-		ret = -EIO;
+		/* still a used descriptor, keep draining the ring */
+		ret = 1;
 	} else {
 		length = (status & DESC_RXSTS_FRMLENMSK) >>
 			 DESC_RXSTS_FRMLENSHFT;
@@ -410,6 +415,22 @@ static int dwc_ether_set_ethaddr(struct eth_device *dev, const unsigned char *ad
 	return 0;
 }
 
+static int dwc_ether_set_allmulti(struct eth_device *dev, int enable)
+{
+	struct dw_eth_dev *priv = dev->priv;
+	struct eth_mac_regs *mac_p = priv->mac_regs_p;
+	u32 filt = readl(&mac_p->framefilt);
+
+	if (enable)
+		filt |= PASSALLMULTICAST;
+	else
+		filt &= ~PASSALLMULTICAST;
+
+	writel(filt, &mac_p->framefilt);
+
+	return 0;
+}
+
 static void dwc_version(struct device_d *dev, u32 hwid)
 {
 	u32 uid = ((hwid & 0x0000ff00) >> 8);
@@ -481,6 +502,8 @@ struct dw_eth_dev *dwc_drv_probe(struct device_d *dev)
 	priv->mac_regs_p = base;
 	dwc_version(dev, readl(&priv->mac_regs_p->version));
 	priv->dma_regs_p = base + DW_DMA_BASE_OFFSET;
+	/* Cores before 3.50a have no feature register and read 0 here */
+	priv->tx_coe = !!(readl(&priv->dma_regs_p->hwfeature) & HWFEAT_TXCOESEL);
 	priv->tx_mac_descrtable = dma_alloc_coherent(
 		CONFIG_TX_DESCR_NUM * sizeof(struct dmamacdescr),
 		DMA_ADDRESS_BROKEN);
@@ -502,6 +525,9 @@ struct dw_eth_dev *dwc_drv_probe(struct device_d *dev)
 	edev->halt = dwc_ether_halt;
 	edev->get_ethaddr = dwc_ether_get_ethaddr;
 	edev->set_ethaddr = dwc_ether_set_ethaddr;
+	edev->set_allmulti = dwc_ether_set_allmulti;
+	if (priv->tx_coe)
+		edev->features |= ETH_FEATURE_TX_CSUM;
 
 	miibus->parent = dev;
 	miibus->read = dwc_ether_mii_read;
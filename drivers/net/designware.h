@@ -29,6 +29,7 @@ struct dw_eth_dev {
 	int phy_addr;
 	phy_interface_t interface;
 	int enh_desc;
+	int tx_coe;
 
 	struct reset_control	*rst;
 };
@@ -41,7 +42,7 @@ struct dw_eth_dev *dwc_drv_probe(struct device_d *dev);
 void dwc_drv_remove(struct device_d *dev);
 
 #define CONFIG_TX_DESCR_NUM	16
-#define CONFIG_RX_DESCR_NUM	16
+#define CONFIG_RX_DESCR_NUM	32
 #define CONFIG_ETH_BUFSIZE	2048
 #define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
 #define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
@@ -72,6 +73,9 @@ struct eth_mac_regs {
 #define RXENABLE		(1 << 2)
 #define TXENABLE		(1 << 3)
 
+/* MAC frame filter register definitions */
+#define PASSALLMULTICAST	(1 << 4)
+
 /* MII address register definitions */
 #define MII_BUSY		(1 << 0)
 #define MII_WRITE		(1 << 1)
@@ -102,6 +106,7 @@ struct eth_dma_regs {
 	u32 currhostrxdesc;	/* 0x4c */
 	u32 currhosttxbuffaddr;	/* 0x50 */
 	u32 currhostrxbuffaddr;	/* 0x54 */
+	u32 hwfeature;		/* 0x58 */
 };
 
 #define DW_DMA_BASE_OFFSET	(0x1000)
@@ -131,6 +136,9 @@ struct eth_dma_regs {
 #define TXSECONDFRAME		(1 << 2)
 #define RXSTART			(1 << 1)
 
+/* HW feature register definitions */
+#define HWFEAT_TXCOESEL		(1 << 16)
+
 /* Descriptior related definitions */
 #define MAC_MAX_FRAME_SZ	(1600)
 
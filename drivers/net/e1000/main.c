@@ -362,6 +362,21 @@ static int e1000_set_ethaddr(struct eth_device *edev, const unsigned char *adr)
 	return 0;
 }
 
+static int e1000_set_allmulti(struct eth_device *edev, int enable)
+{
+	struct e1000_hw *hw = edev->priv;
+	uint32_t rctl = e1000_read_reg(hw, E1000_RCTL);
+
+	if (enable)
+		rctl |= E1000_RCTL_MPE;
+	else
+		rctl &= ~E1000_RCTL_MPE;
+
+	e1000_write_reg(hw, E1000_RCTL, rctl);
+
+	return 0;
+}
+
 /******************************************************************************
  * Clears the VLAN filter table
  *
@@ -3381,6 +3396,12 @@ static void e1000_configure_rx(struct e1000_hw *hw)
 	/* Setup the HW Rx Head and Tail Descriptor Pointers */
 	e1000_write_reg(hw, E1000_RDH, 0);
 	e1000_write_reg(hw, E1000_RDT, 0);
+
+	/* Let the hardware verify IPv4 and TCP/UDP checksums */
+	if (hw->mac_type >= e1000_82543)
+		e1000_write_reg(hw, E1000_RXCSUM,
+				E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL);
+
 	/* Enable Receives */
 
 	if (hw->mac_type == e1000_igb) {
@@ -3399,14 +3420,26 @@ static int e1000_poll(struct eth_device *edev)
 {
 	struct e1000_hw *hw = edev->priv;
 	struct e1000_rx_desc *rd = &hw->rx_base[hw->rx_last];
+	const uint8_t status = readb(&rd->status);
 
-	if (readb(&rd->status) & E1000_RXD_STAT_DD) {
+	if (status & E1000_RXD_STAT_DD) {
 		const uint16_t len = readw(&rd->length);
+		const uint8_t errors = readb(&rd->errors);
+		unsigned int csum = 0;
+
+		if (!(status & E1000_RXD_STAT_IXSM)) {
+			if ((status & E1000_RXD_STAT_IPCS) &&
+			    !(errors & E1000_RXD_ERR_IPE))
+				csum |= NET_RX_CSUM_IP;
+			if ((status & E1000_RXD_STAT_TCPCS) &&
+			    !(errors & E1000_RXD_ERR_TCPE))
+				csum |= NET_RX_CSUM_L4;
+		}
 
 		dma_sync_single_for_cpu(hw->packet_dma, len,
 					DMA_FROM_DEVICE);
 
-		net_receive(edev, hw->packet, len);
+		net_receive_csum(edev, hw->packet, len, csum);
 
 		dma_sync_single_for_device(hw->packet_dma, len,
 					   DMA_FROM_DEVICE);
@@ -3626,6 +3659,7 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	edev->open = e1000_open;
 	edev->get_ethaddr = e1000_get_ethaddr;
 	edev->set_ethaddr = e1000_set_ethaddr;
+	edev->set_allmulti = e1000_set_allmulti;
 
 	hw->miibus.read = e1000_phy_read;
 	hw->miibus.write = e1000_phy_write;
@@ -901,7 +901,6 @@ static int fm_eth_recv(struct eth_device *edev)
 	u32 buf_lo, buf_hi;
 	u8 *data;
 	u16 offset_out;
-	int ret = 1;
 
 	pram = fm_eth->rx_pram;
 	rxbd = fm_eth->cur_rxbd;
@@ -925,7 +924,6 @@ static int fm_eth_recv(struct eth_device *edev)
 						DMA_FROM_DEVICE);
 		} else {
 			dev_err(&edev->dev, "Rx error\n");
-			ret = 0;
 		}
 
 		/* clear the RxBDs */
@@ -949,7 +947,8 @@ static int fm_eth_recv(struct eth_device *edev)
 	}
 	fm_eth->cur_rxbd = rxbd;
 
-	return ret;
+	/* The ring has been drained completely, nothing left to poll */
+	return 0;
 }
 
 static void memac_init_mac(struct fm_eth *fm_eth)
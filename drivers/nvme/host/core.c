@@ -241,32 +241,8 @@ static void nvme_setup_flush(struct nvme_ns *ns, struct nvme_command *cmnd)
 static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 			       void *buffer, int block, int num_blocks)
 {
-	/*
-	 * ns->ctrl->max_hw_sectors is in units of 512 bytes, so we
-	 * need to make sure we adjust it to discovered lba_shift
-	 */
-	const u32 max_hw_sectors =
-		ns->ctrl->max_hw_sectors >> (ns->lba_shift - 9);
 	int ret;
 
-	if (num_blocks > max_hw_sectors) {
-		while (num_blocks) {
-			const int chunk = min_t(int, num_blocks,
-						max_hw_sectors);
-
-			ret = nvme_submit_sync_rw(ns, cmnd, buffer, block,
-						  chunk);
-			if (ret)
-				break;
-
-			num_blocks -= chunk;
-			buffer += chunk;
-			block += chunk;
-		}
-
-		return ret;
-	}
-
 	nvme_setup_rw(ns, cmnd, block, num_blocks);
 
 	ret = __nvme_submit_sync_cmd(ns->ctrl, cmnd, NULL, buffer,
@@ -284,16 +260,108 @@ static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 	return 0;
 }
 
+/*
+ * Split a transfer into commands of at most max_hw_sectors and hand them
+ * to the controller at once, so that it can keep its I/O queue busy.
+ */
+static int nvme_submit_async_rw(struct nvme_ns *ns, u8 opcode, void *buffer,
+				int block, int num_blocks, u32 max_hw_sectors)
+{
+	struct nvme_ctrl *ctrl = ns->ctrl;
+	struct nvme_command *cmds;
+	struct nvme_request *reqs;
+	int i, nr, ret;
+
+	nr = DIV_ROUND_UP(num_blocks, max_hw_sectors);
+
+	cmds = xzalloc(nr * sizeof(*cmds));
+	reqs = xzalloc(nr * sizeof(*reqs));
+
+	for (i = 0; i < nr; i++) {
+		const int chunk = min_t(int, num_blocks, max_hw_sectors);
+
+		cmds[i].rw.opcode = opcode;
+		nvme_setup_rw(ns, &cmds[i], block, chunk);
+
+		reqs[i].cmd = &cmds[i];
+		reqs[i].buffer = buffer;
+		reqs[i].buffer_len = chunk << ns->lba_shift;
+
+		num_blocks -= chunk;
+		buffer += chunk << ns->lba_shift;
+		block += chunk;
+	}
+
+	ret = ctrl->ops->submit_async_cmds(ctrl, reqs, nr, 0, NVME_QID_IO);
+	if (ret) {
+		for (i = 0; i < nr; i++)
+			if (reqs[i].status)
+				break;
+
+		if (i < nr)
+			dev_err(ctrl->dev,
+				"I/O failed: block: %llu, status code type: %xh, status code %02xh\n",
+				le64_to_cpu(cmds[i].rw.slba),
+				(reqs[i].status >> 8) & 0xf,
+				reqs[i].status & 0xff);
+		else
+			dev_err(ctrl->dev, "I/O failed: %s\n", strerror(-ret));
+
+		ret = -EIO;
+	}
+
+	free(reqs);
+	free(cmds);
+
+	return ret;
+}
+
+static int nvme_submit_rw(struct nvme_ns *ns, u8 opcode, void *buffer,
+			  int block, int num_blocks)
+{
+	/*
+	 * ns->ctrl->max_hw_sectors is in units of 512 bytes, so we
+	 * need to make sure we adjust it to discovered lba_shift
+	 */
+	const u32 max_hw_sectors =
+		ns->ctrl->max_hw_sectors >> (ns->lba_shift - 9);
+	struct nvme_command cmnd = { };
+	int ret = 0;
+
+	if (num_blocks <= max_hw_sectors) {
+		cmnd.rw.opcode = opcode;
+		return nvme_submit_sync_rw(ns, &cmnd, buffer, block,
+					   num_blocks);
+	}
+
+	if (ns->ctrl->ops->submit_async_cmds)
+		return nvme_submit_async_rw(ns, opcode, buffer, block,
+					    num_blocks, max_hw_sectors);
+
+	while (num_blocks) {
+		const int chunk = min_t(int, num_blocks, max_hw_sectors);
+
+		memset(&cmnd, 0, sizeof(cmnd));
+		cmnd.rw.opcode = opcode;
+
+		ret = nvme_submit_sync_rw(ns, &cmnd, buffer, block, chunk);
+		if (ret)
+			break;
+
+		num_blocks -= chunk;
+		buffer += chunk << ns->lba_shift;
+		block += chunk;
+	}
+
+	return ret;
+}
 
 static int nvme_block_device_read(struct block_device *blk, void *buffer,
 				  int block, int num_blocks)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
-	struct nvme_command cmnd = { };
 
-	cmnd.rw.opcode = nvme_cmd_read;
-
-	return nvme_submit_sync_rw(ns, &cmnd, buffer, block, num_blocks);
+	return nvme_submit_rw(ns, nvme_cmd_read, buffer, block, num_blocks);
 }
 
 static int __maybe_unused
@@ -301,15 +369,12 @@ nvme_block_device_write(struct block_device *blk, const void *buffer,
 			int block, int num_blocks)
 {
 	struct nvme_ns *ns = to_nvme_ns(blk);
-	struct nvme_command cmnd = { };
 
 	if (ns->readonly)
 		return -EINVAL;
 
-	cmnd.rw.opcode = nvme_cmd_write;
-
-	return nvme_submit_sync_rw(ns, &cmnd, (void *)buffer, block,
-				   num_blocks);
+	return nvme_submit_rw(ns, nvme_cmd_write, (void *)buffer, block,
+			      num_blocks);
 }
 
 static int __maybe_unused nvme_block_device_flush(struct block_device *blk)
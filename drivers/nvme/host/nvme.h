@@ -29,6 +29,7 @@ struct nvme_request {
 	struct nvme_command	*cmd;
 	union nvme_result	result;
 	u16			status;
+	bool			done;
 
 	void *buffer;
 	unsigned int buffer_len;
@@ -86,6 +87,14 @@ struct nvme_ctrl_ops {
 			       void *buffer,
 			       unsigned bufflen,
 			       unsigned timeout, int qid);
+	/*
+	 * Optional: submit @num independent requests, keeping up to the
+	 * queue depth of them in flight. Returns 0 when all of them
+	 * completed successfully.
+	 */
+	int (*submit_async_cmds)(struct nvme_ctrl *ctrl,
+				 struct nvme_request *reqs, int num,
+				 unsigned timeout, int qid);
 };
 
 static inline bool nvme_ctrl_ready(struct nvme_ctrl *ctrl)
@@ -107,6 +116,7 @@ static inline void nvme_end_request(struct nvme_request *rq, __le16 status,
 {
 	rq->status = le16_to_cpu(status) >> 1;
 	rq->result = result;
+	rq->done = true;
 }
 
 int nvme_disable_ctrl(struct nvme_ctrl *ctrl, u64 cap);
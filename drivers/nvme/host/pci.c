@@ -12,19 +12,36 @@
 #define SQ_SIZE(depth)		(depth * sizeof(struct nvme_command))
 #define CQ_SIZE(depth)		(depth * sizeof(struct nvme_completion))
 
-#define NVME_MAX_KB_SZ	4096
+/*
+ * Upper limit for a single command when the controller does not report
+ * MDTS. 32 MiB is also the most a command can move with 512 byte LBAs.
+ */
+#define NVME_MAX_KB_SZ	32768
+
+/* PRP list pages needed for the largest transfer at 4 KiB page size */
+#define NVME_MAX_PRP_PAGES	DIV_ROUND_UP(NVME_MAX_KB_SZ / 4, 4096 / 8 - 1)
 
-static int io_queue_depth = 2;
+static int io_queue_depth = 64;
 
 struct nvme_dev;
 
+/*
+ * PRP list pages of a command slot, allocated from the per device pool
+ * while the command is in flight.
+ */
+struct nvme_prp_list {
+	u16 pages[NVME_MAX_PRP_PAGES];
+	unsigned int npages;
+};
+
 /*
  * An NVM Express queue.  Each device has at least two (one for admin
  * commands and one for I/O commands).
  */
 struct nvme_queue {
 	struct nvme_dev *dev;
-	struct nvme_request *req;
+	struct nvme_request **reqs;	/* outstanding requests by command id */
+	struct nvme_prp_list *prp_lists;
 	struct nvme_command *sq_cmds;
 	volatile struct nvme_completion *cqes;
 	dma_addr_t sq_dma_addr;
@@ -37,6 +54,7 @@ struct nvme_queue {
 	u8 cq_phase;
 
 	u16 counter;
+	u16 inflight;
 };
 
 /*
@@ -53,9 +71,13 @@ struct nvme_dev {
 	void __iomem *bar;
 	bool subsystem;
 	struct nvme_ctrl ctrl;
-	__le64 *prp_pool;
-	unsigned int prp_pool_size;
+
+	/* DMA coherent PRP list pages shared by all I/O commands */
+	void *prp_pool;
 	dma_addr_t prp_dma;
+	u16 *prp_free;
+	unsigned int prp_nr_free;
+	unsigned int prp_pool_pages;
 };
 
 static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
@@ -63,7 +85,62 @@ static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
 	return container_of(ctrl, struct nvme_dev, ctrl);
 }
 
+static inline __le64 *nvme_prp_page(struct nvme_dev *dev, u16 page)
+{
+	return dev->prp_pool + page * dev->ctrl.page_size;
+}
+
+static inline dma_addr_t nvme_prp_page_dma(struct nvme_dev *dev, u16 page)
+{
+	return dev->prp_dma + page * dev->ctrl.page_size;
+}
+
+/*
+ * Each PRP list page holds page_size / 8 entries. When more entries are
+ * needed the last one of a page is used to chain to the next page.
+ */
+static unsigned int nvme_prp_npages(struct nvme_dev *dev, int nprps)
+{
+	const int per_page = dev->ctrl.page_size >> 3;
+
+	return max(1, DIV_ROUND_UP(nprps - 1, per_page - 1));
+}
+
+static void nvme_free_prps(struct nvme_dev *dev, struct nvme_prp_list *list)
+{
+	while (list->npages)
+		dev->prp_free[dev->prp_nr_free++] = list->pages[--list->npages];
+}
+
+static int nvme_alloc_prp_pool(struct nvme_dev *dev)
+{
+	const u32 max_bytes = dev->ctrl.max_hw_sectors << 9;
+	unsigned int npages, i;
+
+	npages = nvme_prp_npages(dev, DIV_ROUND_UP(max_bytes,
+						   dev->ctrl.page_size) + 1);
+
+	/*
+	 * Enough pages to keep a few of the largest commands in flight or
+	 * one page for every command slot of the I/O queue, whatever is
+	 * larger.
+	 */
+	dev->prp_pool_pages = max_t(unsigned int, 4 * npages, dev->q_depth);
+	dev->prp_pool = dma_alloc_coherent(dev->prp_pool_pages *
+					   dev->ctrl.page_size, &dev->prp_dma);
+	if (!dev->prp_pool)
+		return -ENOMEM;
+
+	dev->prp_free = xmalloc(dev->prp_pool_pages * sizeof(*dev->prp_free));
+	for (i = 0; i < dev->prp_pool_pages; i++)
+		dev->prp_free[i] = i;
+	dev->prp_nr_free = dev->prp_pool_pages;
+
+	return 0;
+}
+
 static int nvme_pci_setup_prps(struct nvme_dev *dev,
+			       struct nvme_prp_list *list,
 			       const struct nvme_request *req,
 			       struct nvme_rw_command *cmnd)
 {
@@ -73,7 +150,7 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 	u32 offset = dma_addr & (page_size - 1);
 	u64 prp1 = dma_addr;
 	__le64 *prp_list;
-	int i, nprps;
+	int i, nprps, npages;
 	dma_addr_t prp_dma;
 
 
@@ -91,25 +168,30 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	if (nprps > dev->prp_pool_size) {
-		dma_free_coherent(dev->prp_pool, dev->prp_dma,
-				  dev->prp_pool_size * sizeof(u64));
-		dev->prp_pool_size = nprps;
-		dev->prp_pool = dma_alloc_coherent(nprps * sizeof(u64),
-						   &dev->prp_dma);
-	}
+	npages = nvme_prp_npages(dev, nprps);
+	if (npages > NVME_MAX_PRP_PAGES || npages > dev->prp_pool_pages)
+		return -EINVAL;
+
+	/* wait for other commands to return their pages */
+	if (npages > dev->prp_nr_free)
+		return -EAGAIN;
+
+	while (list->npages < npages)
+		list->pages[list->npages++] = dev->prp_free[--dev->prp_nr_free];
 
-	prp_list = dev->prp_pool;
-	prp_dma  = dev->prp_dma;
+	prp_list = nvme_prp_page(dev, list->pages[0]);
+	prp_dma  = nvme_prp_page_dma(dev, list->pages[0]);
 
 	i = 0;
+	npages = 0;
 	for (;;) {
 		if (i == page_size >> 3) {
 			__le64 *old_prp_list = prp_list;
-			prp_list = &prp_list[i];
-			prp_dma += page_size;
+			u16 page = list->pages[++npages];
+
+			prp_list = nvme_prp_page(dev, page);
 			prp_list[0] = old_prp_list[i - 1];
-			old_prp_list[i - 1] = cpu_to_le64(prp_dma);
+			old_prp_list[i - 1] = cpu_to_le64(nvme_prp_page_dma(dev, page));
 			i = 1;
 		}
 
@@ -127,8 +209,11 @@ done:
 	return 0;
 }
 
-static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
+static int nvme_map_data(struct nvme_dev *dev, struct nvme_prp_list *list,
+			 struct nvme_request *req)
 {
+	int ret;
+
 	if (!req->buffer || !req->buffer_len)
 		return 0;
 
@@ -137,7 +222,12 @@ static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
 	if (dma_mapping_error(dev->dev, req->buffer_dma_addr))
 		return -EFAULT;
 
-	return nvme_pci_setup_prps(dev, req, &req->cmd->rw);
+	ret = nvme_pci_setup_prps(dev, list, req, &req->cmd->rw);
+	if (ret)
+		dma_unmap_single(dev->dev, req->buffer_dma_addr,
+				 req->buffer_len, req->dma_dir);
+
+	return ret;
 }
 
 static void nvme_unmap_data(struct nvme_dev *dev, struct nvme_request *req)
@@ -166,6 +256,9 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	if (!nvmeq->sq_cmds)
 		goto free_cqdma;
 
+	nvmeq->reqs = xzalloc(depth * sizeof(*nvmeq->reqs));
+	nvmeq->prp_lists = xzalloc(depth * sizeof(*nvmeq->prp_lists));
+
 	nvmeq->dev = dev;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
@@ -248,6 +341,7 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 	nvmeq->sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
+	nvmeq->inflight = 0;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	dev->online_queues++;
 }
@@ -279,9 +373,12 @@ release_cq:
 }
 
 /**
- * nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
+ * nvme_submit_cmd() - Copy a command into a queue
  * @nvmeq: The queue to use
  * @cmd: The command to send
+ *
+ * The doorbell is not rung, use nvme_write_sq_db() once all commands
+ * of a batch are queued.
  */
 static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
@@ -289,6 +386,10 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++nvmeq->sq_tail == nvmeq->q_depth)
 		nvmeq->sq_tail = 0;
+}
+
+static inline void nvme_write_sq_db(struct nvme_queue *nvmeq)
+{
 	writel(nvmeq->sq_tail, nvmeq->q_db);
 }
 
@@ -306,10 +407,20 @@ static inline void nvme_ring_cq_doorbell(struct nvme_queue *nvmeq)
 	writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
 }
 
+static void nvme_finish_request(struct nvme_queue *nvmeq, u16 tag)
+{
+	struct nvme_request *req = nvmeq->reqs[tag];
+
+	nvme_unmap_data(nvmeq->dev, req);
+	nvme_free_prps(nvmeq->dev, &nvmeq->prp_lists[tag]);
+	nvmeq->reqs[tag] = NULL;
+	nvmeq->inflight--;
+}
+
 static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 {
 	volatile struct nvme_completion *cqe = &nvmeq->cqes[idx];
-	struct nvme_request *req = nvmeq->req;
+	struct nvme_request *req;
 
 	if (unlikely(cqe->command_id >= nvmeq->q_depth)) {
 		dev_warn(nvmeq->dev->ctrl.dev,
@@ -318,19 +429,12 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 		return;
 	}
 
-	if (WARN_ON(cqe->command_id != req->cmd->common.command_id))
+	req = nvmeq->reqs[cqe->command_id];
+	if (WARN_ON(!req))
 		return;
 
 	nvme_end_request(req, cqe->status, cqe->result);
-}
-
-static void nvme_complete_cqes(struct nvme_queue *nvmeq, u16 start, u16 end)
-{
-	while (start != end) {
-		nvme_handle_cqe(nvmeq, start);
-		if (++start == nvmeq->q_depth)
-			start = 0;
-	}
+	nvme_finish_request(nvmeq, cqe->command_id);
 }
 
 static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
@@ -341,52 +445,102 @@ static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
 	}
 }
 
-static inline bool nvme_process_cq(struct nvme_queue *nvmeq, u16 *start,
-		u16 *end, int tag)
+/*
+ * Reap all pending completions and ring the completion queue doorbell
+ * once for the whole batch. Returns the number of completions.
+ */
+static int nvme_process_cq(struct nvme_queue *nvmeq)
 {
-	bool found = false;
+	int found = 0;
 
-	*start = nvmeq->cq_head;
-	while (!found && nvme_cqe_pending(nvmeq)) {
-		if (nvmeq->cqes[nvmeq->cq_head].command_id == tag)
-			found = true;
+	while (nvme_cqe_pending(nvmeq)) {
+		nvme_handle_cqe(nvmeq, nvmeq->cq_head);
 		nvme_update_cq_head(nvmeq);
+		found++;
 	}
-	*end = nvmeq->cq_head;
 
-	if (*start != *end)
+	if (found)
 		nvme_ring_cq_doorbell(nvmeq);
+
 	return found;
 }
 
-static bool nvme_poll(struct nvme_queue *nvmeq, unsigned int tag)
+static bool nvme_poll(struct nvme_queue *nvmeq, struct nvme_request *req)
 {
-	u16 start, end;
-	bool found;
+	nvme_process_cq(nvmeq);
 
-	if (!nvme_cqe_pending(nvmeq))
-		return false;
+	return req->done;
+}
 
-	found = nvme_process_cq(nvmeq, &start, &end, tag);
+/*
+ * Drop all outstanding requests of a queue, used when the controller
+ * does not answer in time.
+ */
+static void nvme_cancel_requests(struct nvme_queue *nvmeq)
+{
+	u16 tag;
 
-	nvme_complete_cqes(nvmeq, start, end);
-	return found;
+	for (tag = 0; tag < nvmeq->q_depth; tag++)
+		if (nvmeq->reqs[tag])
+			nvme_finish_request(nvmeq, tag);
 }
 
-static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
-				    struct nvme_command *cmd,
-				    union nvme_result *result,
-				    void *buffer,
-				    unsigned int buffer_len,
-				    unsigned timeout, int qid)
+static int nvme_get_tag(struct nvme_queue *nvmeq)
 {
-	struct nvme_dev *dev = to_nvme_dev(ctrl);
-	struct nvme_queue *nvmeq = &dev->queues[qid];
-	struct nvme_request req = { };
-	const u16 tag = nvmeq->counter++ & (nvmeq->q_depth - 1);
-	enum dma_data_direction dma_dir;
-	int ret;
+	int i;
+
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		u16 tag = nvmeq->counter;
+
+		if (++nvmeq->counter == nvmeq->q_depth)
+			nvmeq->counter = 0;
+
+		if (!nvmeq->reqs[tag])
+			return tag;
+	}
+
+	return -EBUSY;
+}
+
+/*
+ * One submission queue entry always stays unused so that a full queue
+ * can be told apart from an empty one.
+ */
+static inline bool nvme_queue_full(struct nvme_queue *nvmeq)
+{
+	return nvmeq->inflight >= nvmeq->q_depth - 1;
+}
+
+static int nvme_queue_rq(struct nvme_queue *nvmeq, struct nvme_request *req)
+{
+	struct nvme_dev *dev = nvmeq->dev;
+	int tag, ret;
+
+	tag = nvme_get_tag(nvmeq);
+	if (tag < 0)
+		return tag;
 
+	req->cmd->common.command_id = tag;
+	req->done = false;
+
+	ret = nvme_map_data(dev, &nvmeq->prp_lists[tag], req);
+	if (ret) {
+		if (ret != -EAGAIN)
+			dev_err(dev->dev, "Failed to map request data\n");
+		return ret;
+	}
+
+	nvmeq->reqs[tag] = req;
+	nvmeq->inflight++;
+
+	nvme_submit_cmd(nvmeq, req->cmd);
+
+	return 0;
+}
+
+static int nvme_pci_dma_dir(struct nvme_command *cmd, int qid,
+			    enum dma_data_direction *dma_dir)
+{
 	switch (qid) {
 	case NVME_QID_ADMIN:
 		switch (cmd->common.opcode) {
@@ -395,10 +549,10 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 		case nvme_admin_delete_sq:
 		case nvme_admin_delete_cq:
 		case nvme_admin_set_features:
-			dma_dir = DMA_TO_DEVICE;
+			*dma_dir = DMA_TO_DEVICE;
 			break;
 		case nvme_admin_identify:
-			dma_dir = DMA_FROM_DEVICE;
+			*dma_dir = DMA_FROM_DEVICE;
 			break;
 		default:
 			return -EINVAL;
@@ -407,10 +561,10 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	case NVME_QID_IO:
 		switch (cmd->rw.opcode) {
 		case nvme_cmd_write:
-			dma_dir = DMA_TO_DEVICE;
+			*dma_dir = DMA_TO_DEVICE;
 			break;
 		case nvme_cmd_read:
-			dma_dir = DMA_FROM_DEVICE;
+			*dma_dir = DMA_FROM_DEVICE;
 			break;
 		default:
 			return -EINVAL;
@@ -420,28 +574,40 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 		return -EINVAL;
 	}
 
-	cmd->common.command_id = tag;
+	return 0;
+}
+
+static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
+				    struct nvme_command *cmd,
+				    union nvme_result *result,
+				    void *buffer,
+				    unsigned int buffer_len,
+				    unsigned timeout, int qid)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[qid];
+	struct nvme_request req = { };
+	int ret;
+
+	ret = nvme_pci_dma_dir(cmd, qid, &req.dma_dir);
+	if (ret)
+		return ret;
 
 	timeout = timeout ?: ADMIN_TIMEOUT;
 
 	req.cmd        = cmd;
 	req.buffer     = buffer;
 	req.buffer_len = buffer_len;
-	req.dma_dir    = dma_dir;
 
-	ret = nvme_map_data(dev, &req);
-	if (ret) {
-		dev_err(dev->dev, "Failed to map request data\n");
+	ret = nvme_queue_rq(nvmeq, &req);
+	if (ret)
 		return ret;
-	}
-
-	nvme_submit_cmd(nvmeq, cmd);
 
-	nvmeq->req = &req;
-	ret = wait_on_timeout(timeout, nvme_poll(nvmeq, tag));
-	nvmeq->req = NULL;
+	nvme_write_sq_db(nvmeq);
 
-	nvme_unmap_data(dev, &req);
+	ret = wait_on_timeout(timeout, nvme_poll(nvmeq, &req));
+	if (ret)
+		nvme_cancel_requests(nvmeq);
 
 	if (result)
 		*result = req.result;
@@ -449,6 +615,67 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	return ret ?: req.status;
 }
 
+static int nvme_pci_submit_async_cmds(struct nvme_ctrl *ctrl,
+				      struct nvme_request *reqs, int num,
+				      unsigned timeout, int qid)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[qid];
+	uint64_t start = get_time_ns();
+	int submitted = 0, completed = 0;
+	int i, ret = 0;
+
+	timeout = timeout ?: ADMIN_TIMEOUT;
+
+	while (completed < submitted || submitted < num) {
+		bool queued = false;
+
+		/* fill up the submission queue */
+		while (!ret && submitted < num && !nvme_queue_full(nvmeq)) {
+			struct nvme_request *req = &reqs[submitted];
+
+			ret = nvme_pci_dma_dir(req->cmd, qid, &req->dma_dir);
+			if (!ret)
+				ret = nvme_queue_rq(nvmeq, req);
+			if (ret == -EAGAIN && nvmeq->inflight) {
+				/* PRP pool exhausted, reap completions first */
+				ret = 0;
+				break;
+			}
+			if (ret)
+				break;
+
+			submitted++;
+			queued = true;
+		}
+
+		if (queued)
+			nvme_write_sq_db(nvmeq);
+
+		/* on errors only wait for the commands already submitted */
+		if (ret)
+			num = submitted;
+
+		i = nvme_process_cq(nvmeq);
+		if (i) {
+			completed += i;
+			start = get_time_ns();
+		} else if (is_timeout(start, timeout)) {
+			nvme_cancel_requests(nvmeq);
+			return -ETIMEDOUT;
+		}
+	}
+
+	if (ret)
+		return ret;
+
+	for (i = 0; i < num; i++)
+		if (reqs[i].status)
+			return reqs[i].status;
+
+	return 0;
+}
+
 static int nvme_pci_configure_admin_queue(struct nvme_dev *dev)
 {
 	int result;
@@ -564,8 +791,8 @@ static void nvme_reset_work(struct nvme_dev *dev)
 		goto out;
 
 	/*
-	 * Limit the max command size to prevent iod->sg allocations going
-	 * over a single page.
+	 * Limit the max command size to what the PRP list of a command
+	 * slot can describe. MDTS may lower this further.
 	 */
 	dev->ctrl.max_hw_sectors = NVME_MAX_KB_SZ << 1;
 
@@ -573,6 +800,12 @@ static void nvme_reset_work(struct nvme_dev *dev)
 	if (result)
 		goto out;
 
+	result = nvme_alloc_prp_pool(dev);
+	if (result) {
+		dev_err(dev->ctrl.dev, "Cannot allocate PRP pool\n");
+		goto out;
+	}
+
 	result = nvme_setup_io_queues(dev);
 	if (result) {
 		dev_err(dev->ctrl.dev, "IO queues not created\n");
@@ -607,6 +840,7 @@ static const struct nvme_ctrl_ops nvme_pci_ctrl_ops = {
 	.reg_write32		= nvme_pci_reg_write32,
 	.reg_read64		= nvme_pci_reg_read64,
 	.submit_sync_cmd	= nvme_pci_submit_sync_cmd,
+	.submit_async_cmds	= nvme_pci_submit_async_cmds,
 };
 
 static void nvme_dev_map(struct nvme_dev *dev)
@@ -642,11 +876,9 @@ static void nvme_disable_io_queues(struct nvme_dev *dev)
 static void nvme_disable_admin_queue(struct nvme_dev *dev)
 {
 	struct nvme_queue *nvmeq = &dev->queues[0];
-	u16 start, end;
 
 	nvme_shutdown_ctrl(&dev->ctrl);
-	nvme_process_cq(nvmeq, &start, &end, -1);
-	nvme_complete_cqes(nvmeq, start, end);
+	nvme_process_cq(nvmeq);
 }
 
 static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
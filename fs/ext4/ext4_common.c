@@ -38,43 +38,151 @@
 
 #include "ext4_common.h"
 
-static struct ext4_extent_header *ext4fs_get_extent_block(struct ext2_data *data,
-		char *buf, struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+/*
+ * Find the extent tree leaf covering fileblock. The last leaf read from disk
+ * is kept in the node, so a sequential read of a file walks the tree only
+ * once per leaf instead of once per block.
+ */
+static struct ext4_extent_header *ext4fs_find_extent_leaf(struct ext2fs_node *node,
+		uint32_t fileblock, uint32_t *leaf_end)
 {
-	struct ext4_extent_idx *index;
-	unsigned long long block;
-	struct ext_filesystem *fs = data->fs;
+	struct ext4_extent_cache *cache = &node->extent_cache;
+	struct ext2_data *data = node->data;
+	struct ext4_extent_header *ext_block;
 	int blksz = EXT2_BLOCK_SIZE(data);
-	int i, ret;
+	int log2_blksz = LOG2_EXT2_BLOCK_SIZE(data);
+	uint32_t first = 0, end = ~0U;
+	int ret;
+
+	if (cache->leaf && fileblock >= cache->first && fileblock < cache->end) {
+		*leaf_end = cache->end;
+		return (struct ext4_extent_header *)cache->leaf;
+	}
+
+	ext_block = (struct ext4_extent_header *)node->inode.b.blocks.dir_blocks;
 
 	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+		struct ext4_extent_idx *index;
+		unsigned long long block;
+		int i, entries;
 
 		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return 0;
+			return NULL;
 
 		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
+			break;
+
+		index = (struct ext4_extent_idx *)(ext_block + 1);
+		entries = le16_to_cpu(ext_block->eh_entries);
+
+		for (i = 0; i < entries; i++)
+			if (fileblock < le32_to_cpu(index[i].ei_block))
 				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
 
 		if (--i < 0)
-			return 0;
+			return NULL;
+
+		first = le32_to_cpu(index[i].ei_block);
+		if (i + 1 < entries)
+			end = le32_to_cpu(index[i + 1].ei_block);
 
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		ret = ext4fs_devread(fs, block << log2_blksz, 0, blksz, buf);
+		if (!cache->leaf) {
+			cache->leaf = malloc(blksz);
+			if (!cache->leaf)
+				return NULL;
+		}
+
+		/* the buffer no longer holds the cached leaf */
+		cache->end = 0;
+
+		ret = ext4fs_devread(data->fs, block << log2_blksz, 0, blksz,
+				cache->leaf);
 		if (ret)
 			return NULL;
-		else
-			ext_block = (struct ext4_extent_header *)buf;
+
+		ext_block = (struct ext4_extent_header *)cache->leaf;
+	}
+
+	if ((char *)ext_block == cache->leaf) {
+		cache->first = first;
+		cache->end = end;
 	}
+
+	*leaf_end = end;
+
+	return ext_block;
+}
+
+static int ext4fs_map_extent(struct ext2fs_node *node, uint32_t fileblock,
+		uint32_t maxblocks, uint64_t *blknr)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	uint32_t leaf_end, next;
+	int entries, lo, hi, i = -1;
+
+	ext_block = ext4fs_find_extent_leaf(node, fileblock, &leaf_end);
+	if (!ext_block) {
+		pr_err("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+
+	/* find the last extent starting at or before fileblock */
+	lo = 0;
+	hi = entries - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if (le32_to_cpu(extent[mid].ee_block) <= fileblock) {
+			i = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	if (i >= 0) {
+		uint32_t offset = fileblock - le32_to_cpu(extent[i].ee_block);
+		uint32_t len = le16_to_cpu(extent[i].ee_len);
+		bool uninit = len > EXT4_EXT_INIT_MAX_LEN;
+		unsigned long long start;
+
+		if (uninit)
+			len -= EXT4_EXT_INIT_MAX_LEN;
+
+		if (offset < len) {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+
+			/* uninitialized extents read back as zeroes */
+			*blknr = uninit ? 0 : start + offset;
+
+			return min(len - offset, maxblocks);
+		}
+	}
+
+	/* a hole up to the next extent */
+	if (i + 1 < entries)
+		next = le32_to_cpu(extent[i + 1].ee_block);
+	else
+		next = leaf_end;
+
+	/* unsorted or overlapping extents would map nothing here */
+	if (next <= fileblock) {
+		pr_err("corrupted extent tree at block %u\n", fileblock);
+		return -EIO;
+	}
+
+	*blknr = 0;
+
+	return min(next - fileblock, maxblocks);
 }
 
 static int ext4fs_blockgroup(struct ext2_data *data, int group,
@@ -157,7 +265,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	struct ext2_inode *inode = &node->inode;
 	struct ext2_data *data = node->data;
 	int ret;
@@ -167,47 +274,13 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-
-		if (!buf)
-			return -ENOMEM;
-
-		ext_block = ext4fs_get_extent_block(node->data, buf,
-				(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
-				fileblock, log2_blksz);
-		if (!ext_block) {
-			pr_err("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
+		uint64_t blk;
 
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
-
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
+		ret = ext4fs_map_extent(node, fileblock, 1, &blk);
+		if (ret < 0)
+			return ret;
 
-		free(buf);
-		return -EIO;
+		return blk;
 	}
 
 	if (fileblock < INDIRECT_BLOCKS) {
@@ -265,6 +338,44 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	return blknr;
 }
 
+/**
+ * ext4fs_map_blocks - map file blocks to disk blocks
+ * @node: the file
+ * @fileblock: first file block to map
+ * @maxblocks: number of blocks the caller is interested in
+ * @blknr: returns the disk block @fileblock is stored in, 0 for a hole
+ *
+ * Return: the number of blocks from @fileblock on which are stored in
+ * consecutive disk blocks (or are all part of a hole), at most @maxblocks,
+ * or a negative error code. For files with extents this is resolved from
+ * a single extent, for files with indirect blocks block by block.
+ */
+int ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+		      uint32_t maxblocks, uint64_t *blknr)
+{
+	long int blk, next;
+	uint32_t count;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(node, fileblock, maxblocks, blknr);
+
+	blk = read_allocated_block(node, fileblock);
+	if (blk < 0)
+		return blk;
+
+	for (count = 1; count < maxblocks; count++) {
+		next = read_allocated_block(node, fileblock + count);
+		if (next < 0)
+			break;
+		if (blk ? next != blk + count : next != 0)
+			break;
+	}
+
+	*blknr = blk;
+
+	return count;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -557,6 +668,7 @@ fail:
 
 void ext4fs_umount(struct ext_filesystem *fs)
 {
+	free(fs->data->diropen.extent_cache.leaf);
 	free(fs->data->indir1.data);
 	free(fs->data->indir2.data);
 	free(fs->data->indir3.data);
@@ -0,0 +1,486 @@
+/*
+ * ext4 hash indexed directory (htree) lookup
+ *
+ * The hash functions are taken from the Linux kernel's fs/ext4/hash.c:
+ *
+ * Copyright (C) 2002 by Theodore Ts'o
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/bitops.h>
+#include <asm/byteorder.h>
+
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+/* root plus at most two levels of index blocks */
+#define EXT4_HTREE_LEVEL		3
+
+#define EXT4_HTREE_EOF_32BIT		((1UL << (32 - 1)) - 1)
+
+/* Follows the fake "." and ".." entries in the first directory block */
+struct dx_root_info {
+	__le32 reserved_zero;
+	u8 hash_version;
+	u8 info_length;
+	u8 indirect_levels;
+	u8 unused_flags;
+};
+
+#define DX_ROOT_INFO_OFFSET	24
+/* Index blocks start with a fake empty directory entry */
+#define DX_NODE_OFFSET		8
+
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+/* Overlays the hash of the first dx_entry of each index block */
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	struct dx_entry *at;
+	unsigned int count;
+};
+
+#define DELTA 0x9E3779B9
+
+static void TEA_transform(u32 buf[4], u32 const in[])
+{
+	u32 sum = 0;
+	u32 b0 = buf[0], b1 = buf[1];
+	u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = rol32(a, s))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+static void half_md4_transform(u32 buf[4], u32 const in[8])
+{
+	u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	ROUND(F, a, b, c, d, in[0] + K1,  3);
+	ROUND(F, d, a, b, c, in[1] + K1,  7);
+	ROUND(F, c, d, a, b, in[2] + K1, 11);
+	ROUND(F, b, c, d, a, in[3] + K1, 19);
+	ROUND(F, a, b, c, d, in[4] + K1,  3);
+	ROUND(F, d, a, b, c, in[5] + K1,  7);
+	ROUND(F, c, d, a, b, in[6] + K1, 11);
+	ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	ROUND(G, a, b, c, d, in[1] + K2,  3);
+	ROUND(G, d, a, b, c, in[3] + K2,  5);
+	ROUND(G, c, d, a, b, in[5] + K2,  9);
+	ROUND(G, b, c, d, a, in[7] + K2, 13);
+	ROUND(G, a, b, c, d, in[0] + K2,  3);
+	ROUND(G, d, a, b, c, in[2] + K2,  5);
+	ROUND(G, c, d, a, b, in[4] + K2,  9);
+	ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	ROUND(H, a, b, c, d, in[3] + K3,  3);
+	ROUND(H, d, a, b, c, in[7] + K3,  9);
+	ROUND(H, c, d, a, b, in[2] + K3, 11);
+	ROUND(H, b, c, d, a, in[6] + K3, 15);
+	ROUND(H, a, b, c, d, in[1] + K3,  3);
+	ROUND(H, d, a, b, c, in[5] + K3,  9);
+	ROUND(H, c, d, a, b, in[0] + K3, 11);
+	ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+#undef ROUND
+#undef K1
+#undef K2
+#undef K3
+#undef F
+#undef G
+#undef H
+
+/* The old legacy hash */
+static u32 dx_hack_hash(const char *name, int len, bool unsigned_char)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int i, c;
+
+	for (i = 0; i < len; i++) {
+		if (unsigned_char)
+			c = (unsigned char)name[i];
+		else
+			c = (signed char)name[i];
+
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return hash0 << 1;
+}
+
+static void str2hashbuf(const char *msg, int len, u32 *buf, int num,
+			bool unsigned_char)
+{
+	u32 pad, val;
+	int i, c;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		if (unsigned_char)
+			c = (unsigned char)msg[i];
+		else
+			c = (signed char)msg[i];
+
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+static u32 ext4fs_dirhash(struct ext2_data *data, const char *name, int len,
+			  unsigned int version)
+{
+	bool unsigned_char = version >= DX_HASH_LEGACY_UNSIGNED;
+	u32 buf[4], in[8], hash = 0;
+	const char *p;
+	int i;
+
+	/* Initialize the default seed for the hash checksum functions */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	/* Use the seed from the superblock unless it is all zeroes */
+	for (i = 0; i < 4; i++) {
+		if (data->sblock.hash_seed[i]) {
+			for (i = 0; i < 4; i++)
+				buf[i] = le32_to_cpu(data->sblock.hash_seed[i]);
+			break;
+		}
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY:
+	case DX_HASH_LEGACY_UNSIGNED:
+		hash = dx_hack_hash(name, len, unsigned_char);
+		break;
+	case DX_HASH_HALF_MD4:
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		for (p = name; len > 0; len -= 32, p += 32) {
+			str2hashbuf(p, len, in, 8, unsigned_char);
+			half_md4_transform(buf, in);
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA:
+	case DX_HASH_TEA_UNSIGNED:
+		for (p = name; len > 0; len -= 16, p += 16) {
+			str2hashbuf(p, len, in, 4, unsigned_char);
+			TEA_transform(buf, in);
+		}
+		hash = buf[0];
+		break;
+	}
+
+	hash &= ~1;
+	if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+		hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+
+	return hash;
+}
+
+static int dx_read_block(struct ext2fs_node *dir, uint32_t block, char *buf)
+{
+	unsigned int blksz = EXT2_BLOCK_SIZE(dir->data);
+	int ret;
+
+	ret = ext4fs_read_file(dir, block * blksz, blksz, buf);
+	if (ret < 0)
+		return ret;
+	if (ret != blksz)
+		return -EIO;
+
+	return 0;
+}
+
+static inline uint32_t dx_get_block(struct dx_entry *entry)
+{
+	return le32_to_cpu(entry->block) & 0x0fffffff;
+}
+
+/*
+ * Set up a frame for the index entries at the given position of its block.
+ * Returns false if the count/limit header does not look sane.
+ */
+static bool dx_init_frame(struct dx_frame *frame, unsigned int offset,
+			  unsigned int blksz)
+{
+	struct dx_countlimit *cl = (void *)(frame->buf + offset);
+	unsigned int count = le16_to_cpu(cl->count);
+	unsigned int limit = le16_to_cpu(cl->limit);
+
+	if (!count || count > limit ||
+	    offset + limit * sizeof(struct dx_entry) > blksz)
+		return false;
+
+	frame->entries = (struct dx_entry *)cl;
+	frame->count = count;
+
+	return true;
+}
+
+/* Find the index entry whose hash range contains hash */
+static void dx_find_entry(struct dx_frame *frame, uint32_t hash)
+{
+	struct dx_entry *p = frame->entries + 1;
+	struct dx_entry *q = frame->entries + frame->count - 1;
+
+	while (p <= q) {
+		struct dx_entry *m = p + (q - p) / 2;
+
+		if (le32_to_cpu(m->hash) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+
+	frame->at = p - 1;
+}
+
+/*
+ * Names whose hashes collide may continue in the following leaf, which
+ * then starts with the same hash and the collision bit set. Advance the
+ * frames to that leaf. Returns 1 if there is one, 0 if not.
+ */
+static int dx_next_block(struct ext2fs_node *dir, struct dx_frame *frames,
+			 struct dx_frame *frame, uint32_t hash)
+{
+	unsigned int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame *p = frame;
+	int ret;
+
+	while (1) {
+		p->at++;
+		if (p->at < p->entries + p->count)
+			break;
+		if (p == frames)
+			return 0;
+		p--;
+	}
+
+	if ((le32_to_cpu(p->at->hash) & ~1) != hash)
+		return 0;
+
+	while (p < frame) {
+		ret = dx_read_block(dir, dx_get_block(p->at), (p + 1)->buf);
+		if (ret)
+			return ret;
+		p++;
+		if (!dx_init_frame(p, DX_NODE_OFFSET, blksz))
+			return -EINVAL;
+		p->at = p->entries;
+	}
+
+	return 1;
+}
+
+static int dx_search_leaf(char *buf, unsigned int blksz, const char *name,
+			  int namelen, int *inum)
+{
+	unsigned int off = 0;
+
+	while (off + sizeof(struct ext2_dirent) <= blksz) {
+		struct ext2_dirent *dirent = (void *)(buf + off);
+		unsigned int direntlen = le16_to_cpu(dirent->direntlen);
+
+		if (direntlen < sizeof(*dirent) || off + direntlen > blksz)
+			return -EINVAL;
+
+		if (dirent->inode && dirent->namelen == namelen &&
+		    sizeof(*dirent) + namelen <= direntlen &&
+		    !memcmp(dirent + 1, name, namelen)) {
+			*inum = le32_to_cpu(dirent->inode);
+			return 1;
+		}
+
+		off += direntlen;
+	}
+
+	return 0;
+}
+
+/**
+ * ext4fs_dx_lookup - look up a name in a hash indexed directory
+ * @dir: the directory
+ * @name: the name to look up
+ * @namelen: length of @name
+ * @inum: returns the inode number, 0 if the name does not exist
+ *
+ * Only the leaf blocks the name's hash points to are read.
+ *
+ * Return: 0 on success, -EOPNOTSUPP if @dir has no usable index and has to
+ * be scanned linearly, or another negative error code.
+ */
+int ext4fs_dx_lookup(struct ext2fs_node *dir, const char *name, int namelen,
+		     int *inum)
+{
+	struct ext2_data *data = dir->data;
+	unsigned int blksz = EXT2_BLOCK_SIZE(data);
+	struct dx_frame frames[EXT4_HTREE_LEVEL] = {}, *frame;
+	struct dx_root_info *info;
+	unsigned int version, levels, i;
+	uint32_t hash;
+	char *leaf = NULL;
+	int ret;
+
+	if (!(le32_to_cpu(data->sblock.feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL))
+		return -EOPNOTSUPP;
+
+	frames[0].buf = malloc(blksz);
+	if (!frames[0].buf)
+		return -ENOMEM;
+
+	ret = dx_read_block(dir, 0, frames[0].buf);
+	if (ret)
+		goto out;
+
+	ret = -EOPNOTSUPP;
+
+	info = (void *)(frames[0].buf + DX_ROOT_INFO_OFFSET);
+	if (info->reserved_zero || info->info_length < sizeof(*info))
+		goto out;
+
+	version = info->hash_version;
+	if (version <= DX_HASH_TEA &&
+	    (le32_to_cpu(data->sblock.flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		version += DX_HASH_LEGACY_UNSIGNED;
+	if (version > DX_HASH_TEA_UNSIGNED)
+		goto out;
+
+	levels = info->indirect_levels;
+	if (levels >= EXT4_HTREE_LEVEL)
+		goto out;
+
+	hash = ext4fs_dirhash(data, name, namelen, version);
+
+	if (!dx_init_frame(&frames[0], DX_ROOT_INFO_OFFSET + info->info_length,
+			   blksz))
+		goto out;
+
+	for (i = 0; ; i++) {
+		frame = &frames[i];
+		dx_find_entry(frame, hash);
+
+		if (i == levels)
+			break;
+
+		frames[i + 1].buf = malloc(blksz);
+		if (!frames[i + 1].buf) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		ret = dx_read_block(dir, dx_get_block(frame->at),
+				    frames[i + 1].buf);
+		if (ret)
+			goto out;
+
+		ret = -EOPNOTSUPP;
+		if (!dx_init_frame(&frames[i + 1], DX_NODE_OFFSET, blksz))
+			goto out;
+	}
+
+	leaf = malloc(blksz);
+	if (!leaf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	*inum = 0;
+
+	while (1) {
+		ret = dx_read_block(dir, dx_get_block(frame->at), leaf);
+		if (ret)
+			break;
+
+		ret = dx_search_leaf(leaf, blksz, name, namelen, inum);
+		if (ret)
+			break;
+
+		ret = dx_next_block(dir, frames, frame, hash);
+		if (ret <= 0)
+			break;
+	}
+
+	if (ret > 0)
+		ret = 0;
+out:
+	free(leaf);
+	for (i = 0; i < EXT4_HTREE_LEVEL; i++)
+		free(frames[i].buf);
+
+	return ret;
+}
@@ -38,115 +38,65 @@
 
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
-	if ((node != &node->data->diropen) && (node != currroot))
+	if ((node != &node->data->diropen) && (node != currroot)) {
+		free(node->extent_cache.leaf);
 		free(node);
+	}
 }
 
 /*
- * Taken from openmoko-kernel mailing list: By Andy green
- * Optimized read file API : collects and defers contiguous sector
- * reads into one potentially more efficient larger sequential read action
+ * Read a file range with as few device reads as possible: each run of
+ * blocks ext4fs_map_blocks() resolves in one go - a whole extent for files
+ * using extents - is read with a single request.
  */
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf)
 {
-	int i;
-	int blockcnt;
 	int log2blocksize = LOG2_EXT2_BLOCK_SIZE(node->data);
-	int blocksize = 1 << (log2blocksize + DISK_SECTOR_BITS);
+	int log2blksz = log2blocksize + DISK_SECTOR_BITS;
+	unsigned int blocksize = 1 << log2blksz;
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	int previous_block_number = -1;
-	int delayed_start = 0;
-	int delayed_extent = 0;
-	int delayed_skipfirst = 0;
-	int delayed_next = 0;
-	char *delayed_buf = NULL;
-	short ret;
+	unsigned int remaining;
 	struct ext_filesystem *fs = node->data->fs;
+	int ret;
 
-	/* Adjust len so it we can't read past the end of the file. */
-	if (len > filesize)
-		len = filesize;
+	if (pos >= filesize)
+		return 0;
 
-	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
+	/* Adjust len so it we can't read past the end of the file. */
+	if (len > filesize - pos)
+		len = filesize - pos;
 
-	for (i = pos / blocksize; i < blockcnt; i++) {
-		int blknr;
-		int blockoff = pos % blocksize;
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(node, i);
-		if (blknr < 0)
-			return blknr;
+	remaining = len;
 
-		blknr = blknr << log2blocksize;
+	while (remaining) {
+		uint32_t fileblock = pos >> log2blksz;
+		unsigned int blockoff = pos & (blocksize - 1);
+		uint32_t nblocks = (blockoff + remaining + blocksize - 1) >> log2blksz;
+		uint64_t blknr, now;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) % blocksize;
+		ret = ext4fs_map_blocks(node, fileblock, nblocks, &blknr);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EIO;
 
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		now = ((uint64_t)ret << log2blksz) - blockoff;
+		if (now > remaining)
+			now = remaining;
 
-		/* First block. */
-		if (i == pos / blocksize) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
 		if (blknr) {
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> SECTOR_BITS;
-				} else {	/* spill */
-					ret = ext4fs_devread(fs, delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (ret)
-						return ret;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> SECTOR_BITS);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> SECTOR_BITS);
-			}
+			ret = ext4fs_devread(fs, blknr << log2blocksize,
+					blockoff, now, buf);
+			if (ret)
+				return ret;
 		} else {
-			if (previous_block_number != -1) {
-				/* spill */
-				ret = ext4fs_devread(fs, delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (ret)
-					return ret;
-				previous_block_number = -1;
-			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, now);
 		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		ret = ext4fs_devread(fs, delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (ret)
-			return ret;
-		previous_block_number = -1;
+
+		pos += now;
+		buf += now;
+		remaining -= now;
 	}
 
 	return len;
@@ -24,13 +24,19 @@
 #ifndef __EXT4__
 #define __EXT4__
 
+#define EXT4_INDEX_FL		0x00001000 /* hash-indexed directory */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+/* ee_len values above this mark an uninitialized extent */
+#define EXT4_EXT_INIT_MAX_LEN		(1 << 15)
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
 #define EXT4_INDIRECT_BLOCKS		12
 
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
 #define EXT4_BG_INODE_UNINIT		0x0001
 #define EXT4_BG_BLOCK_UNINIT		0x0002
 #define EXT4_BG_INODE_ZEROED		0x0004
@@ -126,5 +132,9 @@ char *ext4fs_read_symlink(struct ext2fs_node *node);
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(struct ext_filesystem *fs, int sector, int byte_offset, int byte_len, char *buf);
 long int read_allocated_block(struct ext2fs_node *node, int fileblock);
+int ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+		      uint32_t maxblocks, uint64_t *blknr);
+int ext4fs_dx_lookup(struct ext2fs_node *dir, const char *name, int namelen,
+		     int *inum);
 
 #endif
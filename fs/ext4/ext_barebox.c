@@ -74,8 +74,17 @@ static struct inode *ext_alloc_inode(struct super_block *sb)
 	return &node->i;
 }
 
+static void ext_destroy_inode(struct inode *inode)
+{
+	struct ext2fs_node *node = to_ext2_node(inode);
+
+	free(node->extent_cache.leaf);
+	free(node);
+}
+
 static const struct super_operations ext_ops = {
 	.alloc_inode = ext_alloc_inode,
+	.destroy_inode = ext_destroy_inode,
 };
 
 struct inode *ext_get_inode(struct super_block *sb, int ino);
@@ -85,6 +94,10 @@ static int ext4fs_get_ino(struct ext2fs_node *dir, struct qstr *name, int *inum)
 	unsigned int fpos = 0;
 	int ret;
 
+	ret = ext4fs_dx_lookup(dir, name->name, name->len, inum);
+	if (ret != -EOPNOTSUPP)
+		return ret;
+
 	while (fpos < le32_to_cpu(dir->inode.size)) {
 		struct ext2_dirent dirent;
 
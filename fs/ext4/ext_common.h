@@ -209,12 +209,20 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* The extent tree leaf which was used last for a file */
+struct ext4_extent_cache {
+	char *leaf;		/* leaf block, NULL if none was read yet */
+	uint32_t first;		/* first file block covered by the leaf */
+	uint32_t end;		/* first file block after the leaf */
+};
+
 struct ext2fs_node {
 	struct inode i;
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext4_extent_cache extent_cache;
 };
 
 struct ext4fs_indir_block {
@@ -39,12 +39,12 @@ struct fat_priv {
 
 /* ---------------------------------------------------------------*/
 
-DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, BYTE count)
+DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, UINT count)
 {
 	struct fat_priv *priv = fat->userdata;
 	int ret;
 
-	debug("%s: sector: %ld count: %d\n", __func__, sector, count);
+	debug("%s: sector: %ld count: %u\n", __func__, sector, count);
 
 	ret = cdev_read(priv->cdev, buf, count << 9, (loff_t)sector * 512, 0);
 	if (ret != count << 9)
@@ -53,12 +53,12 @@ DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, BYTE count)
 	return 0;
 }
 
-DRESULT disk_write(FATFS *fat, const BYTE *buf, DWORD sector, BYTE count)
+DRESULT disk_write(FATFS *fat, const BYTE *buf, DWORD sector, UINT count)
 {
 	struct fat_priv *priv = fat->userdata;
 	int ret;
 
-	debug("%s: buf: %p sector: %ld count: %d\n",
+	debug("%s: buf: %p sector: %ld count: %u\n",
 			__func__, buf, sector, count);
 
 	ret = cdev_write(priv->cdev, buf, count << 9, (loff_t)sector * 512, 0);
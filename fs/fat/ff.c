@@ -257,6 +257,7 @@ int move_window (
 			fs->wflag = 0;
 			if (wsect < (fs->fatbase + fs->fsize)) {	/* In FAT area */
 				BYTE nf;
+				fs->fatwinsect = 0;	/* Invalidate FAT window */
 				for (nf = fs->n_fats; nf > 1; nf--) {	/* Reflect the change to all FAT copies */
 					wsect += fs->fsize;
 					disk_write(fs, fs->win, wsect, 1);
@@ -324,6 +325,40 @@ static DWORD clust2sect (	/* !=0: Sector number, 0: Failed - invalid cluster# */
 	return clst * fs->csize + fs->database;
 }
 
+/*
+ * FAT access - Get a pointer to byte bc of the first FAT
+ *
+ * Chain lookups go through fatwin[], which holds FAT_WIN_SECTORS
+ * sectors of the FAT at once, so that following a cluster chain does
+ * not compete with directory accesses for the single sector win[].
+ * A FAT sector currently in win[] may be dirty and is used from there.
+ */
+static BYTE *fat_byte (	/* NULL: Disk error */
+	FATFS *fs,	/* File system object */
+	UINT bc		/* Byte offset into the FAT */
+)
+{
+	DWORD sect = fs->fatbase + bc / SS(fs);
+	DWORD start;
+	UINT n;
+
+	if (sect == fs->winsect)
+		return &fs->win[bc % SS(fs)];
+
+	start = sect - (sect - fs->fatbase) % FAT_WIN_SECTORS;
+	if (fs->fatwinsect != start) {
+		n = FAT_WIN_SECTORS;
+		if (start + n > fs->fatbase + fs->fsize)
+			n = fs->fatbase + fs->fsize - start;
+		fs->fatwinsect = 0;
+		if (disk_read(fs, fs->fatwin, start, n) != RES_OK)
+			return NULL;
+		fs->fatwinsect = start;
+	}
+
+	return &fs->fatwin[(sect - start) * SS(fs) + bc % SS(fs)];
+}
+
 /*
  * FAT access - Read value of a FAT entry
  */
@@ -342,30 +377,58 @@ static DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster
 	switch (fs->fs_type) {
 	case FS_FAT12 :
 		bc = (UINT)clst; bc += bc / 2;
-		if (move_window(fs, fs->fatbase + (bc / SS(fs))))
+		p = fat_byte(fs, bc);
+		if (!p)
 			break;
-		wc = fs->win[bc % SS(fs)]; bc++;
-		if (move_window(fs, fs->fatbase + (bc / SS(fs))))
+		wc = *p; bc++;
+		p = fat_byte(fs, bc);
+		if (!p)
 			break;
-		wc |= fs->win[bc % SS(fs)] << 8;
+		wc |= *p << 8;
 		return (clst & 1) ? (wc >> 4) : (wc & 0xFFF);
 
 	case FS_FAT16 :
-		if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 2))))
+		p = fat_byte(fs, clst * 2);
+		if (!p)
 			break;
-		p = &fs->win[clst * 2 % SS(fs)];
 		return LD_WORD(p);
 
 	case FS_FAT32 :
-		if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))))
+		p = fat_byte(fs, clst * 4);
+		if (!p)
 			break;
-		p = &fs->win[clst * 4 % SS(fs)];
 		return LD_DWORD(p) & 0x0FFFFFFF;
 	}
 
 	return 0xFFFFFFFF;	/* An error occurred at the disk I/O layer */
 }
 
+/*
+ * Follow the cluster chain from fp->clust as long as it stays contiguous
+ * on the disk, covering at most nsect sectors. fp->clust is advanced to
+ * the last cluster that was followed. Returns the number of sectors in
+ * the clusters followed, clipped to nsect.
+ */
+static UINT follow_contiguous (
+	FIL *fp,	/* Pointer to the file object */
+	UINT nsect	/* Number of sectors wanted beyond fp->clust */
+)
+{
+	FATFS *fs = fp->fs;
+	DWORD next;
+	UINT cnt = 0;
+
+	while (cnt < nsect) {
+		next = get_fat(fs, fp->clust);
+		if (next != fp->clust + 1 || next >= fs->n_fatent)
+			break;	/* Fragmented, end of chain or error: leave it to the caller */
+		fp->clust = next;
+		cnt += fs->csize;
+	}
+
+	return cnt < nsect ? cnt : nsect;
+}
+
 
 
 
@@ -1688,6 +1751,7 @@ static int chk_mounted (	/* 0(0): successful, !=0: any error occurred */
 #endif
 	fs->fs_type = fmt; /* FAT sub-type */
 	fs->winsect = 0; /* Invalidate sector cache */
+	fs->fatwinsect = 0;
 	fs->wflag = 0;
 
 	return 0;
@@ -1866,9 +1930,10 @@ int f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);		/* When remaining bytes >= sector size, */
 			if (cc) {			/* Read maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs, rbuff, sect, (BYTE)cc) != RES_OK)
+				if (csect + cc > fp->fs->csize)	/* Extend over contiguous clusters */
+					cc = fp->fs->csize - csect +
+						follow_contiguous(fp, csect + cc - fp->fs->csize);
+				if (disk_read(fp->fs, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, -EIO);
 #if defined CONFIG_FS_FAT_WRITE
 				/* Replace one of the read sectors with cached data if it contains a dirty sector */
@@ -1970,7 +2035,7 @@ int f_write (
 				/* Write maximum contiguous sectors directly */
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_write(fp->fs, wbuff, sect, (BYTE)cc) != RES_OK)
+				if (disk_write(fp->fs, wbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, -EIO);
 				if (fp->dsect - sect < cc) {
 					/* Refill sector cache if it gets invalidated by the direct write */
@@ -52,6 +52,8 @@ typedef char TCHAR;
 
 /* File system object structure (FATFS) */
 
+#define FAT_WIN_SECTORS	32	/* Sectors of the FAT held in fatwin[] */
+
 typedef struct {
 	BYTE	fs_type;	/* FAT sub-type (0:Not mounted) */
 	BYTE	drv;		/* Physical drive number */
@@ -75,6 +77,8 @@ typedef struct {
 	DWORD	database;	/* Data start sector */
 	DWORD	winsect;	/* Current sector appearing in the win[] */
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and Data on tiny cfg) */
+	DWORD	fatwinsect;	/* First FAT sector appearing in the fatwin[] (0:empty) */
+	BYTE	fatwin[FAT_WIN_SECTORS * _MAX_SS];	/* Read-only FAT window for chain lookups */
 	void	*userdata;	/* User data, ff core does not touch this */
 	struct list_head dirtylist;
 } FATFS;
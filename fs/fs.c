@@ -1785,15 +1785,17 @@ static struct fs_device_d *get_fsdevice_by_dentry(struct dentry *dentry)
 	return container_of(sb, struct fs_device_d, sb);
 }
 
-static bool dentry_is_tftp(struct dentry *dentry)
+static bool dentry_is_flat_netfs(struct dentry *dentry)
 {
 	struct fs_device_d *fsdev;
+	const char *name;
 
 	fsdev = get_fsdevice_by_dentry(dentry);
 	if (!fsdev)
 		return false;
 
-	if (strcmp(fsdev->driver->drv.name, "tftp"))
+	name = fsdev->driver->drv.name;
+	if (strcmp(name, "tftp") && strcmp(name, "http"))
 		return false;
 
 	return true;
@@ -1874,13 +1876,13 @@ OK:
 			return err;
 
 		/*
-		 * barebox specific hack for TFTP. TFTP does not support
+		 * barebox specific hack for TFTP and HTTP. They do not support
 		 * looking up directories, only the files in directories.
 		 * Since the filename is not known at this point we replace
-		 * the path separator with an invalid char so that TFTP will
-		 * get the full remaining path including slashes.
+		 * the path separator with an invalid char so that the driver
+		 * will get the full remaining path including slashes.
 		 */
-		if (dentry_is_tftp(nd->path.dentry))
+		if (dentry_is_flat_netfs(nd->path.dentry))
 			separator = 0x1;
 
 		if (err) {
@@ -2297,7 +2299,7 @@ int open(const char *pathname, int flags, ...)
 			goto out1;
 		}
 	} else {
-		if (d_is_dir(dentry) && !dentry_is_tftp(dentry)) {
+		if (d_is_dir(dentry) && !dentry_is_flat_netfs(dentry)) {
 			error = -EISDIR;
 			goto out1;
 		}
@@ -0,0 +1,513 @@
+/*
+ * http.c - read only filesystem on top of a HTTP/1.1 server
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#define pr_fmt(fmt) "http: " fmt
+
+#include <common.h>
+#include <net.h>
+#include <driver.h>
+#include <fs.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <init.h>
+#include <malloc.h>
+#include <linux/stat.h>
+#include <linux/err.h>
+#include <linux/ctype.h>
+
+#define HTTP_PORT	80
+#define HTTP_LINE_MAX	1024
+
+struct http_priv {
+	IPaddr_t server;
+	uint16_t port;
+	char *host;
+};
+
+struct http_response {
+	int status;
+	loff_t length;		/* Content-Length, -1 if not given */
+	loff_t size;		/* Size of the whole file, -1 if unknown */
+	int chunked;
+};
+
+struct file_priv {
+	struct http_priv *hpriv;
+	char *path;
+	struct tcp_connection *tc;
+	loff_t pos;		/* File position of the next byte from tc */
+	loff_t remain;		/* Body bytes left, -1: until the server closes */
+	int chunked;
+	loff_t chunk;		/* Bytes left in the current chunk */
+	int eof;
+};
+
+static int http_getline(struct tcp_connection *tc, char *line, int size)
+{
+	int len = 0, ret;
+	char c;
+
+	while (1) {
+		ret = tcp_read(tc, &c, 1);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EPIPE;
+
+		if (c == '\n')
+			break;
+		if (c != '\r' && len < size - 1)
+			line[len++] = c;
+	}
+
+	line[len] = 0;
+
+	return len;
+}
+
+static int http_status_to_errno(int status)
+{
+	switch (status) {
+	case 200:
+	case 206:
+		return 0;
+	case 401:
+	case 403:
+		return -EACCES;
+	case 404:
+	case 410:
+		return -ENOENT;
+	default:
+		return -EIO;
+	}
+}
+
+/*
+ * http_request - send a request and parse the response header
+ *
+ * On success the connection is positioned at the start of the body.
+ */
+static struct tcp_connection *http_request(struct http_priv *hpriv,
+		const char *method, const char *path, loff_t pos,
+		struct http_response *resp)
+{
+	struct tcp_connection *tc;
+	char *req, *line, *p;
+	int ret;
+
+	tc = tcp_open(hpriv->server, hpriv->port);
+	if (IS_ERR(tc))
+		return tc;
+
+	if (pos)
+		req = basprintf("%s %s HTTP/1.1\r\n"
+				"Host: %s\r\n"
+				"User-Agent: barebox\r\n"
+				"Range: bytes=%lld-\r\n"
+				"Connection: close\r\n\r\n",
+				method, path, hpriv->host, pos);
+	else
+		req = basprintf("%s %s HTTP/1.1\r\n"
+				"Host: %s\r\n"
+				"User-Agent: barebox\r\n"
+				"Connection: close\r\n\r\n",
+				method, path, hpriv->host);
+
+	ret = tcp_write(tc, req, strlen(req));
+	free(req);
+	if (ret < 0)
+		goto out;
+
+	line = xmalloc(HTTP_LINE_MAX);
+
+	ret = http_getline(tc, line, HTTP_LINE_MAX);
+	if (ret < 0)
+		goto out_free;
+
+	/* HTTP/1.1 206 Partial Content */
+	p = strchr(line, ' ');
+	if (strncmp(line, "HTTP/1.", 7) || !p) {
+		ret = -EPROTO;
+		goto out_free;
+	}
+
+	resp->status = simple_strtoul(p + 1, NULL, 10);
+	resp->length = -1;
+	resp->size = -1;
+	resp->chunked = 0;
+
+	pr_debug("%s %s: %s\n", method, path, line);
+
+	while (1) {
+		ret = http_getline(tc, line, HTTP_LINE_MAX);
+		if (ret < 0)
+			goto out_free;
+		if (!ret)
+			break;
+
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		*p++ = 0;
+		while (isspace(*p))
+			p++;
+
+		if (!strcasecmp(line, "Content-Length")) {
+			resp->length = simple_strtoull(p, NULL, 10);
+		} else if (!strcasecmp(line, "Content-Range")) {
+			/* bytes <first>-<last>/<size> */
+			p = strchr(p, '/');
+			if (p && p[1] != '*')
+				resp->size = simple_strtoull(p + 1, NULL, 10);
+		} else if (!strcasecmp(line, "Transfer-Encoding")) {
+			if (strstr(p, "chunked"))
+				resp->chunked = 1;
+		}
+	}
+
+	if (resp->status == 200 && resp->length >= 0 && !resp->chunked)
+		resp->size = resp->length;
+
+	free(line);
+
+	return tc;
+
+out_free:
+	free(line);
+out:
+	tcp_close(tc);
+
+	return ERR_PTR(ret);
+}
+
+/*
+ * http_body_read - read from the body of the current response
+ *
+ * Returns the number of bytes read, 0 at the end of the body.
+ */
+static int http_body_read(struct file_priv *priv, void *buf, size_t insize)
+{
+	char line[32];
+	int ret;
+
+	if (priv->eof)
+		return 0;
+
+	if (priv->chunked) {
+		/* chunk-size [; ext] CRLF data CRLF ... 0 CRLF */
+		while (!priv->chunk) {
+			ret = http_getline(priv->tc, line, sizeof(line));
+			if (ret < 0)
+				return ret;
+			if (!ret)
+				continue;	/* CRLF after the previous chunk */
+
+			priv->chunk = simple_strtoull(line, NULL, 16);
+			if (!priv->chunk) {
+				priv->eof = 1;
+				return 0;
+			}
+		}
+		insize = min_t(loff_t, insize, priv->chunk);
+	}
+
+	if (priv->remain >= 0)
+		insize = min_t(loff_t, insize, priv->remain);
+
+	if (!insize) {
+		priv->eof = 1;
+		return 0;
+	}
+
+	ret = tcp_read(priv->tc, buf, insize);
+	if (ret <= 0) {
+		if (!ret)
+			priv->eof = 1;
+		return ret;
+	}
+
+	if (priv->chunked)
+		priv->chunk -= ret;
+	if (priv->remain >= 0)
+		priv->remain -= ret;
+
+	return ret;
+}
+
+static void http_stop(struct file_priv *priv)
+{
+	if (priv->tc)
+		tcp_close(priv->tc);
+	priv->tc = NULL;
+}
+
+/*
+ * http_start - (re)start the transfer of a file at pos
+ */
+static int http_start(struct file_priv *priv, loff_t pos)
+{
+	struct http_response resp;
+	struct tcp_connection *tc;
+	loff_t skip = 0;
+	char *buf;
+	int ret;
+
+	http_stop(priv);
+
+	tc = http_request(priv->hpriv, "GET", priv->path, pos, &resp);
+	if (IS_ERR(tc))
+		return PTR_ERR(tc);
+
+	priv->tc = tc;
+	priv->pos = pos;
+	priv->remain = resp.length;
+	priv->chunked = resp.chunked;
+	priv->chunk = 0;
+	priv->eof = 0;
+
+	if (resp.status == 416) {
+		/* Range not satisfiable: we are at or beyond the end */
+		priv->eof = 1;
+		return 0;
+	}
+
+	ret = http_status_to_errno(resp.status);
+	if (ret)
+		goto err;
+
+	/* The server ignored our range request, skip to pos */
+	if (pos && resp.status == 200)
+		skip = pos;
+
+	if (!skip)
+		return 0;
+
+	buf = xmalloc(PAGE_SIZE);
+
+	while (skip) {
+		ret = http_body_read(priv, buf, min_t(loff_t, skip, PAGE_SIZE));
+		if (ret <= 0) {
+			if (!ret)
+				priv->eof = 1;
+			break;
+		}
+		skip -= ret;
+	}
+
+	free(buf);
+
+	if (ret >= 0)
+		return 0;
+err:
+	http_stop(priv);
+
+	return ret;
+}
+
+static int http_open(struct device_d *dev, FILE *file, const char *filename)
+{
+	struct fs_device_d *fsdev = dev_to_fs_device(dev);
+	struct file_priv *priv;
+
+	if ((file->flags & O_ACCMODE) != O_RDONLY)
+		return -EROFS;
+
+	priv = xzalloc(sizeof(*priv));
+	priv->hpriv = dev->priv;
+	priv->path = dpath(file->dentry, fsdev->vfsmount.mnt_root);
+
+	file->priv = priv;
+	file->size = file->f_inode->i_size;
+
+	return 0;
+}
+
+static int http_close(struct device_d *dev, FILE *file)
+{
+	struct file_priv *priv = file->priv;
+
+	http_stop(priv);
+	free(priv->path);
+	free(priv);
+
+	return 0;
+}
+
+static int http_read(struct device_d *dev, FILE *file, void *buf, size_t insize)
+{
+	struct file_priv *priv = file->priv;
+	int ret;
+
+	/* Connect lazily and start over with a range request after a seek */
+	if (!priv->tc || priv->pos != file->pos) {
+		ret = http_start(priv, file->pos);
+		if (ret)
+			return ret;
+	}
+
+	ret = http_body_read(priv, buf, insize);
+	if (ret > 0)
+		priv->pos += ret;
+
+	return ret;
+}
+
+static int http_lseek(struct device_d *dev, FILE *file, loff_t pos)
+{
+	return 0;
+}
+
+static const struct inode_operations http_file_inode_operations;
+static const struct inode_operations http_dir_inode_operations;
+static const struct file_operations http_file_operations;
+
+static struct inode *http_get_inode(struct super_block *sb, umode_t mode)
+{
+	struct inode *inode = new_inode(sb);
+
+	if (!inode)
+		return NULL;
+
+	inode->i_ino = get_next_ino();
+	inode->i_mode = mode;
+
+	switch (mode & S_IFMT) {
+	default:
+		return NULL;
+	case S_IFREG:
+		inode->i_op = &http_file_inode_operations;
+		inode->i_fop = &http_file_operations;
+		break;
+	case S_IFDIR:
+		inode->i_op = &http_dir_inode_operations;
+		inode->i_fop = &simple_dir_operations;
+		inc_nlink(inode);
+		break;
+	}
+
+	return inode;
+}
+
+static struct dentry *http_lookup(struct inode *dir, struct dentry *dentry,
+			    unsigned int flags)
+{
+	struct super_block *sb = dir->i_sb;
+	struct fs_device_d *fsdev = container_of(sb, struct fs_device_d, sb);
+	struct http_priv *hpriv = fsdev->dev.priv;
+	struct http_response resp;
+	struct tcp_connection *tc;
+	struct inode *inode;
+	char *path;
+
+	path = dpath(dentry, fsdev->vfsmount.mnt_root);
+	tc = http_request(hpriv, "HEAD", path, 0, &resp);
+	free(path);
+	if (IS_ERR(tc))
+		return NULL;
+
+	tcp_close(tc);
+
+	if (http_status_to_errno(resp.status))
+		return NULL;
+
+	inode = http_get_inode(dir->i_sb, S_IFREG | S_IRWXUGO);
+	if (!inode)
+		return ERR_PTR(-ENOMEM);
+
+	if (resp.size >= 0)
+		inode->i_size = resp.size;
+	else
+		inode->i_size = FILE_SIZE_STREAM;
+
+	d_add(dentry, inode);
+
+	return NULL;
+}
+
+static const struct inode_operations http_dir_inode_operations =
+{
+	.lookup = http_lookup,
+};
+
+static const struct super_operations http_ops;
+
+static int http_probe(struct device_d *dev)
+{
+	struct fs_device_d *fsdev = dev_to_fs_device(dev);
+	struct http_priv *priv = xzalloc(sizeof(struct http_priv));
+	struct super_block *sb = &fsdev->sb;
+	struct inode *inode;
+	char *port;
+	int ret;
+
+	dev->priv = priv;
+
+	priv->host = xstrdup(fsdev->backingstore);
+	priv->port = HTTP_PORT;
+
+	port = strchr(priv->host, ':');
+	if (port) {
+		*port = 0;
+		priv->port = simple_strtoul(port + 1, NULL, 10);
+	}
+
+	ret = resolv(priv->host, &priv->server);
+	if (ret) {
+		pr_err("Cannot resolve \"%s\": %s\n", priv->host, strerror(-ret));
+		goto err;
+	}
+
+	/* Host: header, including a non-default port */
+	if (port)
+		*port = ':';
+
+	sb->s_op = &http_ops;
+
+	inode = http_get_inode(sb, S_IFDIR);
+	sb->s_root = d_make_root(inode);
+
+	return 0;
+err:
+	free(priv->host);
+	free(priv);
+
+	return ret;
+}
+
+static void http_remove(struct device_d *dev)
+{
+	struct http_priv *priv = dev->priv;
+
+	free(priv->host);
+	free(priv);
+}
+
+static struct fs_driver_d http_driver = {
+	.open      = http_open,
+	.close     = http_close,
+	.read      = http_read,
+	.lseek     = http_lseek,
+	.flags     = 0,
+	.drv = {
+		.probe  = http_probe,
+		.remove = http_remove,
+		.name = "http",
+	}
+};
+
+static int http_init(void)
+{
+	return register_fs_driver(&http_driver);
+}
+coredevice_initcall(http_init);
@@ -125,6 +125,17 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(2 * SECOND)
 #define NFS_MAX_RESEND	5
 
+/*
+ * Default READ size. Chosen so that a READ reply including the RPC, IP
+ * and UDP headers still fits into a single ethernet frame. Larger values
+ * can be given with the rsize= mount option.
+ */
+#define NFS_RSIZE	1280
+#define NFS_MAX_RSIZE	32768
+
+/* Number of READ requests kept in flight while reading a file */
+#define NFS_MAX_READS	8
+
 struct nfs_fh {
 	unsigned short size;
 	unsigned char data[NFS3_FHSIZE];
@@ -144,8 +155,18 @@ struct nfs_priv {
 	uint16_t nfs_port;
 	unsigned manual_nfs_port:1;
 	uint32_t rpc_id;
+	unsigned short rsize;
 	struct nfs_fh rootfh;
 	struct packet *nfs_packet;
+	struct list_head files;
+};
+
+struct nfs_read {
+	uint32_t xid;
+	uint64_t offset;
+	uint32_t count;
+	uint64_t sent;
+	struct packet *reply;
 };
 
 struct file_priv {
@@ -153,6 +174,14 @@ struct file_priv {
 	void *buf;
 	struct nfs_priv *npriv;
 	struct nfs_fh fh;
+	loff_t size;
+	struct list_head list;
+
+	/* READ requests in flight, reads[head] is the next one to consume */
+	struct nfs_read reads[NFS_MAX_READS];
+	int head;
+	int num_reads;
+	uint64_t next_offset;
 };
 
 struct nfs_inode {
@@ -398,21 +427,18 @@ static int rpc_check_reply(struct packet *pkt, int rpc_prog,
 }
 
 /*
- * rpc_req - synchronous RPC request
+ * rpc_prepare - Put an RPC call into the packet buffer of the connection
+ *
+ * Returns the length of the UDP payload to send.
  */
-static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
-			      int rpc_proc, uint32_t *data, int datalen)
+static int rpc_prepare(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		       uint32_t rpc_id, uint32_t *data, int datalen)
 {
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int nfserr;
-	int tries = 0;
 
-	npriv->rpc_id++;
-
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(rpc_id);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -436,11 +462,29 @@ static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
+	return sizeof(pkt) + datalen * sizeof(uint32_t);
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
+			      int rpc_proc, uint32_t *data, int datalen)
+{
+	int ret, len;
+	int nfserr;
+	int tries = 0;
+
+	npriv->rpc_id++;
+	npriv->nfs_packet = NULL;
+
+	len = rpc_prepare(npriv, rpc_prog, rpc_proc, npriv->rpc_id,
+			  data, datalen);
+
 	nfs_timer_start = get_time_ns();
 
 again:
-	ret = net_udp_send(npriv->con,
-			sizeof(pkt) + datalen * sizeof(uint32_t));
+	ret = net_udp_send(npriv->con, len);
 	if (ret) {
 		if (is_timeout(nfs_timer_start, NFS_TIMEOUT)) {
 			tries++;
@@ -875,16 +919,13 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * nfs_read_send - Send the READ request for one slot of the read pipeline
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static int nfs_read_send(struct file_priv *priv, struct nfs_read *r)
 {
 	uint32_t data[1024];
 	uint32_t *p;
 	int len;
-	struct packet *nfs_packet;
-	uint32_t rlen, eof;
 
 	/*
 	 * struct READ3args {
@@ -892,7 +933,118 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, &priv->fh);
+	p = nfs_add_uint64(p, r->offset);
+	p = nfs_add_uint32(p, r->count);
+
+	len = rpc_prepare(priv->npriv, PROG_NFS, NFSPROC3_READ, r->xid,
+			  data, p - &(data[0]));
+
+	r->sent = get_time_ns();
+
+	return net_udp_send(priv->npriv->con, len);
+}
+
+/*
+ * nfs_read_fill - Issue READ requests until NFS_MAX_READS are in flight
+ *
+ * Requests are not sent beyond the known file size, but there is always at
+ * least one, so that we learn about the end of file from the server.
+ */
+static int nfs_read_fill(struct file_priv *priv)
+{
+	struct nfs_priv *npriv = priv->npriv;
+	struct nfs_read *r;
+	int ret;
+
+	while (priv->num_reads < NFS_MAX_READS &&
+	       (!priv->num_reads || priv->next_offset < priv->size)) {
+		r = &priv->reads[(priv->head + priv->num_reads) % NFS_MAX_READS];
+		r->xid = ++npriv->rpc_id;
+		r->offset = priv->next_offset;
+		r->count = npriv->rsize;
+		r->reply = NULL;
+
+		ret = nfs_read_send(priv, r);
+		if (ret)
+			return ret;
+
+		priv->num_reads++;
+		priv->next_offset += r->count;
+	}
+
+	return 0;
+}
+
+static void nfs_read_cancel(struct file_priv *priv)
+{
+	struct nfs_read *r;
+
+	while (priv->num_reads) {
+		r = &priv->reads[priv->head];
+		free(r->reply);
+		r->reply = NULL;
+		priv->head = (priv->head + 1) % NFS_MAX_READS;
+		priv->num_reads--;
+	}
+}
+
+/*
+ * nfs_read_reply - Pass a received packet to the READ request it answers
+ *
+ * Replies may arrive in any order, they are kept in their slot until the
+ * reader gets there. Returns true if the packet was consumed.
+ */
+static bool nfs_read_reply(struct nfs_priv *npriv, struct packet *pkt)
+{
+	struct file_priv *priv;
+	struct nfs_read *r;
+	uint32_t xid;
+	int i;
+
+	xid = ntoh32(net_read_uint32(pkt->data));
+
+	list_for_each_entry(priv, &npriv->files, list) {
+		for (i = 0; i < priv->num_reads; i++) {
+			r = &priv->reads[(priv->head + i) % NFS_MAX_READS];
+			if (r->xid != xid)
+				continue;
+
+			if (r->reply)
+				free(pkt);	/* duplicate answer to a resend */
+			else
+				r->reply = pkt;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * nfs_read_req - Read File on NFS Server
+ *
+ * Copies the data at offset to dest, what does not fit there goes into the
+ * fifo. Up to NFS_MAX_READS READ requests for the following parts of the
+ * file are kept in flight, so that sequential reads do not wait for a full
+ * round trip per request.
+ */
+static int nfs_read_req(struct file_priv *priv, uint64_t offset,
+			struct net_rx_dest *dest)
+{
+	struct nfs_read *r;
+	struct packet *nfs_packet;
+	uint32_t *p;
+	uint32_t rlen, eof;
+	int i, ret, nfserr;
+	int tries = 0;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -911,18 +1063,52 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
+	if (priv->num_reads && priv->reads[priv->head].offset != offset)
+		nfs_read_cancel(priv);
+	if (!priv->num_reads)
+		priv->next_offset = offset;
 
-	p = nfs_add_fh3(p, &priv->fh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
+	ret = nfs_read_fill(priv);
+	if (ret)
+		goto err;
 
-	len = p - &(data[0]);
+	r = &priv->reads[priv->head];
 
-	nfs_packet = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (IS_ERR(nfs_packet))
-		return PTR_ERR(nfs_packet);
+	while (!r->reply) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto err;
+		}
+
+		net_poll();
+
+		if (is_timeout(r->sent, NFS_TIMEOUT)) {
+			tries++;
+			if (tries == NFS_MAX_RESEND) {
+				ret = -ETIMEDOUT;
+				goto err;
+			}
+
+			for (i = 0; i < priv->num_reads; i++) {
+				struct nfs_read *rr;
+
+				rr = &priv->reads[(priv->head + i) % NFS_MAX_READS];
+				if (!rr->reply)
+					nfs_read_send(priv, rr);
+			}
+		}
+	}
+
+	nfs_packet = r->reply;
+	r->reply = NULL;
+	priv->head = (priv->head + 1) % NFS_MAX_READS;
+	priv->num_reads--;
+
+	ret = rpc_check_reply(nfs_packet, PROG_NFS, r->xid, &nfserr);
+	if (!ret)
+		ret = nfserr;
+	if (ret)
+		goto err_free;
 
 	p = (void *)nfs_packet->data + sizeof(struct rpc_reply) + 4;
 
@@ -941,28 +1127,57 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 */
 	p += 2;
 
-	if (readlen && !rlen && !eof) {
-		free(nfs_packet);
-		return -EIO;
+	if ((!rlen && !eof) || rlen > r->count) {
+		ret = -EIO;
+		goto err_free;
 	}
 
-	kfifo_put(priv->fifo, (char *)p, rlen);
+	net_rx_deliver(dest, priv->fifo, p, rlen);
 
 	free(nfs_packet);
 
+	/*
+	 * The requests behind a short read do not continue where it ended,
+	 * start over from there.
+	 */
+	if (eof || rlen < r->count) {
+		nfs_read_cancel(priv);
+		priv->next_offset = r->offset + rlen;
+	}
+
 	return 0;
+
+err_free:
+	free(nfs_packet);
+err:
+	nfs_read_cancel(priv);
+
+	return ret;
 }
 
 static void nfs_handler(void *ctx, char *packet, unsigned len)
 {
 	char *pkt = net_eth_to_udp_payload(packet);
 	struct nfs_priv *npriv = ctx;
+	struct packet *nfs_packet;
+
+	nfs_packet = xmalloc(sizeof(*nfs_packet) + len);
+	memcpy(nfs_packet->data, pkt, len);
+	nfs_packet->len = len;
+
+	if (nfs_read_reply(npriv, nfs_packet))
+		return;
+
+	/* Only the reply to the pending synchronous request is of interest */
+	if (nfs_state != STATE_START ||
+	    ntoh32(net_read_uint32(nfs_packet->data)) != npriv->rpc_id) {
+		free(nfs_packet);
+		return;
+	}
 
 	nfs_state = STATE_DONE;
 
-	npriv->nfs_packet = xmalloc(sizeof(*npriv->nfs_packet) + len);
-	memcpy(npriv->nfs_packet->data, pkt, len);
-	npriv->nfs_packet->len = len;
+	npriv->nfs_packet = nfs_packet;
 }
 
 static int nfs_truncate(struct device_d *dev, FILE *f, loff_t size)
@@ -972,6 +1187,9 @@ static int nfs_truncate(struct device_d *dev, FILE *f, loff_t size)
 
 static void nfs_do_close(struct file_priv *priv)
 {
+	nfs_read_cancel(priv);
+	list_del(&priv->list);
+
 	if (priv->fifo)
 		kfifo_free(priv->fifo);
 
@@ -1058,13 +1276,16 @@ static int nfs_open(struct device_d *dev, FILE *file, const char *filename)
 	priv->npriv = npriv;
 	file->priv = priv;
 	file->size = inode->i_size;
+	priv->size = inode->i_size;
 
-	priv->fifo = kfifo_alloc(1024);
+	priv->fifo = kfifo_alloc(npriv->rsize);
 	if (!priv->fifo) {
 		free(priv);
 		return -ENOMEM;
 	}
 
+	list_add(&priv->list, &npriv->files);
+
 	return 0;
 }
 
@@ -1086,17 +1307,18 @@ static int nfs_write(struct device_d *_dev, FILE *file, const void *inbuf,
 static int nfs_read(struct device_d *dev, FILE *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->priv;
-
-	if (insize > 1024)
-		insize = 1024;
+	struct net_rx_dest rx = {
+		.buf = buf,
+		.len = insize,
+	};
 
 	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->pos, insize);
+		int ret = nfs_read_req(priv, file->pos, &rx);
 		if (ret)
 			return ret;
 	}
 
-	return kfifo_get(priv->fifo, buf, insize);
+	return insize - rx.len + kfifo_get(priv->fifo, rx.buf, rx.len);
 }
 
 static int nfs_lseek(struct device_d *dev, FILE *file, loff_t pos)
@@ -1104,6 +1326,7 @@ static int nfs_lseek(struct device_d *dev, FILE *file, loff_t pos)
 	struct file_priv *priv = file->priv;
 
 	kfifo_reset(priv->fifo);
+	nfs_read_cancel(priv);
 
 	return 0;
 }
@@ -1318,6 +1541,7 @@ static int nfs_probe(struct device_d *dev)
 	int ret;
 
 	dev->priv = npriv;
+	INIT_LIST_HEAD(&npriv->files);
 
 	debug("nfs: mount: %s\n", fsdev->backingstore);
 
@@ -1374,6 +1598,11 @@ static int nfs_probe(struct device_d *dev)
 	}
 	debug("nfs port: %d\n", npriv->nfs_port);
 
+	npriv->rsize = NFS_RSIZE;
+	parseopt_hu(fsdev->options, "rsize", &npriv->rsize);
+	npriv->rsize = clamp_t(unsigned short, npriv->rsize, 512, NFS_MAX_RSIZE);
+	debug("nfs rsize: %hu\n", npriv->rsize);
+
 	ret = nfs_mount_req(npriv);
 	if (ret) {
 		printf("mounting failed with %d\n", ret);
@@ -68,7 +68,9 @@
 #define STATE_DONE	8
 
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
-#define TFTP_FIFO_SIZE		4096
+#define TFTP_MTU_SIZE		1432	/* MTU based block size we ask for */
+#define TFTP_MAX_WINDOW_SIZE	CONFIG_FS_TFTP_MAX_WINDOW_SIZE
+#define TFTP_FIFO_SIZE		max(4096, TFTP_MAX_WINDOW_SIZE * TFTP_MTU_SIZE)
 
 #define TFTP_ERR_RESEND	1
 
@@ -84,9 +86,13 @@ struct file_priv {
 	uint64_t resend_timeout;
 	uint64_t progress_timeout;
 	struct kfifo *fifo;
+	struct net_rx_dest rx;	/* caller's buffer while tftp_read() polls */
 	void *buf;
 	int blocksize;
+	int windowsize;
 	int block_requested;
+	int ack_pending;
+	int reack_sent;		/* gap in the window already acknowledged */
 };
 
 struct tftp_priv {
@@ -138,21 +144,37 @@ static int tftp_send(struct file_priv *priv)
 				"tsize%c"
 				"%lld%c"
 				"blksize%c"
-				"1432",
+				"%d",
 				priv->filename + 1, 0,
 				0,
 				0,
 				TIMEOUT, 0,
 				0,
 				priv->filesize, 0,
-				0);
+				0,
+				TFTP_MTU_SIZE);
 		pkt++;
+		if (!priv->push && TFTP_MAX_WINDOW_SIZE > 1) {
+			pkt += sprintf((unsigned char *)pkt,
+					"windowsize%c"
+					"%d",
+					0,
+					TFTP_MAX_WINDOW_SIZE);
+			pkt++;
+		}
 		len = pkt - xp;
 		break;
 
 	case STATE_RDATA:
-		if (priv->block == priv->block_requested)
+		/*
+		 * Acknowledge only at the end of a window, after a lost
+		 * block, or when the resend timer asks us to.
+		 */
+		if (priv->block_requested >= 0 && !priv->ack_pending)
 			return 0;
+		priv->block = priv->last_block;
+		priv->ack_pending = 0;
+		/* fall through */
 	case STATE_OACK:
 		xp = pkt;
 		s = (uint16_t *)pkt;
@@ -202,6 +224,7 @@ static int tftp_poll(struct file_priv *priv)
 		printf("T ");
 		priv->resend_timeout = get_time_ns();
 		priv->block_requested = -1;
+		priv->reack_sent = 0;
 		return TFTP_ERR_RESEND;
 	}
 
@@ -238,6 +261,10 @@ static void tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 			priv->filesize = simple_strtoull(val, NULL, 10);
 		if (!strcmp(opt, "blksize"))
 			priv->blocksize = simple_strtoul(val, NULL, 10);
+		if (!strcmp(opt, "windowsize"))
+			priv->windowsize = clamp_t(int,
+					simple_strtoul(val, NULL, 10),
+					1, TFTP_MAX_WINDOW_SIZE);
 		pr_debug("OACK opt: %s val: %s\n", opt, val);
 		s = val + strlen(val) + 1;
 	}
@@ -327,17 +354,34 @@ static void tftp_recv(struct file_priv *priv,
 			}
 		}
 
-		if (priv->block == priv->last_block)
-			/* Same block again; ignore it. */
+		if (priv->block != (uint16_t)(priv->last_block + 1)) {
+			/*
+			 * Same block again or a block of the window got lost.
+			 * Drop it and acknowledge the last block received in
+			 * sequence once per gap, so that the server restarts
+			 * the window from there (RFC 7440).
+			 */
+			if (priv->block != priv->last_block &&
+			    !priv->reack_sent) {
+				priv->ack_pending = 1;
+				priv->reack_sent = 1;
+			}
 			break;
+		}
 
 		priv->last_block = priv->block;
+		priv->reack_sent = 0;
 
 		tftp_timer_reset(priv);
 
-		kfifo_put(priv->fifo, pkt + 2, len);
+		net_rx_deliver(&priv->rx, priv->fifo, pkt + 2, len);
+
+		if ((uint16_t)(priv->last_block - priv->block_requested) >=
+		    priv->windowsize)
+			priv->ack_pending = 1;
 
 		if (len < priv->blocksize) {
+			priv->ack_pending = 1;
 			tftp_send(priv);
 			priv->err = 0;
 			priv->state = STATE_DONE;
@@ -401,6 +445,7 @@ static struct file_priv *tftp_do_open(struct device_d *dev,
 	priv->err = -EINVAL;
 	priv->filename = dpath(dentry, fsdev->vfsmount.mnt_root);
 	priv->blocksize = TFTP_BLOCK_SIZE;
+	priv->windowsize = 1;
 	priv->block_requested = -1;
 
 	priv->fifo = kfifo_alloc(TFTP_FIFO_SIZE);
@@ -560,10 +605,22 @@ static int tftp_read(struct device_d *dev, FILE *f, void *buf, size_t insize)
 		if (priv->state == STATE_DONE)
 			return outsize;
 
-		if (TFTP_FIFO_SIZE - kfifo_len(priv->fifo) >= priv->blocksize)
+		if (TFTP_FIFO_SIZE - kfifo_len(priv->fifo) >=
+		    priv->blocksize * priv->windowsize)
 			tftp_send(priv);
 
+		/* Let blocks arriving in sequence land in buf directly */
+		priv->rx.buf = buf;
+		priv->rx.len = insize;
+
 		ret = tftp_poll(priv);
+
+		now = insize - priv->rx.len;
+		priv->rx.len = 0;
+		outsize += now;
+		buf += now;
+		insize -= now;
+
 		if (ret == TFTP_ERR_RESEND)
 			tftp_send(priv);
 		if (ret < 0)
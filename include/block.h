@@ -21,10 +21,30 @@ struct block_device {
 	int blockbits;
 	int num_blocks;
 	int rdbufsize;
+	int rdbufbits;
 	int blkmask;
 
 	struct list_head buffered_blocks;
 	struct list_head idle_blocks;
+	struct hlist_head *chunk_hash;
+	unsigned int chunk_hash_mask;
+
+	uint32_t cache_chunksize;
+	uint32_t cache_chunks;
+	uint32_t cache_hits;
+	uint32_t cache_misses;
+	uint32_t cache_evictions;
+	uint32_t cache_readahead;
+
+	void *readahead_buf;
+	int readahead_max;
+	int readahead_window;
+	int readahead_next;
+	uint32_t readahead_ios;
+	uint32_t readahead_chunks;
+	uint32_t readahead_hits;
+
+	struct param_d *params[9];
 
 	struct cdev cdev;
 };
@@ -74,7 +74,6 @@ struct image_data {
 	char *oftree_file;
 	char *oftree_part;
 
-	const void *fit_kernel;
 	unsigned long fit_kernel_size;
 	void *fit_config;
 
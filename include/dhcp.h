@@ -10,6 +10,8 @@
 #ifndef __DHCP_H__
 #define __DHCP_H__
 
+#include <net.h>
+
 #define DHCP_DEFAULT_RETRY 20
 
 struct dhcp_req_param {
@@ -26,7 +28,7 @@ struct dhcp_result {
 	IPaddr_t ip;
 	IPaddr_t netmask;
 	IPaddr_t gateway;
-	IPaddr_t nameserver;
+	IPaddr_t nameserver[NET_MAX_NAMESERVERS];
 	IPaddr_t serverip;
 	IPaddr_t dhcp_serverip;
 	char *hostname;
@@ -42,8 +44,13 @@ struct eth_device;
 
 int dhcp_request(struct eth_device *edev, const struct dhcp_req_param *param,
 		 struct dhcp_result **res);
+int dhcp_request_any(struct eth_device **edevs, int num,
+		     const struct dhcp_req_param *param,
+		     struct eth_device **bound, struct dhcp_result **res);
 int dhcp_set_result(struct eth_device *edev, struct dhcp_result *res);
 void dhcp_result_free(struct dhcp_result *res);
 int dhcp(struct eth_device *edev, const struct dhcp_req_param *param);
+int dhcp_any(struct eth_device **edevs, int num,
+	     const struct dhcp_req_param *param, struct eth_device **bound);
 
 #endif
@@ -19,6 +19,7 @@
 #define __IMAGE_FIT_H__
 
 #include <linux/types.h>
+#include <linux/list.h>
 #include <bootm.h>
 
 struct fit_handle {
@@ -32,6 +33,10 @@ struct fit_handle {
 	struct device_node *root;
 	struct device_node *images;
 	struct device_node *configurations;
+
+	/* opened from a file: image payloads are read from fd on demand */
+	int fd;
+	struct list_head data_list;
 };
 
 struct fit_handle *fit_open(const char *filename, bool verbose,
@@ -44,6 +49,10 @@ int fit_has_image(struct fit_handle *handle, void *configuration,
 int fit_open_image(struct fit_handle *handle, void *configuration,
 		   const char *name, const void **outdata,
 		   unsigned long *outsize);
+int fit_get_image_size(struct fit_handle *handle, void *configuration,
+		       const char *name, unsigned long *size);
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, void *dest, unsigned long size);
 
 void fit_close(struct fit_handle *handle);
 
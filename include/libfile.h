@@ -23,6 +23,8 @@ int compare_file(const char *f1, const char *f2);
 
 int open_and_lseek(const char *filename, int mode, loff_t pos);
 
+int open_for_write(const char *filename, loff_t size);
+
 /* Create a directory and its parents */
 int make_directory(const char *pathname);
 
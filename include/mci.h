@@ -63,10 +63,20 @@
 #define MMC_CAP_SD_HIGHSPEED		(1 << 3)
 #define MMC_CAP_MMC_HIGHSPEED		(1 << 4)
 #define MMC_CAP_MMC_HIGHSPEED_52MHZ	(1 << 5)
+#define MMC_CAP_CMD23			(1 << 6)
+#define MMC_CAP_MMC_HS200		(1 << 7)
+#define MMC_CAP_MMC_HS400		(1 << 8)
+#define MMC_CAP_UHS_SDR50		(1 << 9)
+#define MMC_CAP_UHS_SDR104		(1 << 10)
+#define MMC_CAP_UHS_DDR50		(1 << 11)
 /* Mask of all caps for bus width */
 #define MMC_CAP_BIT_DATA_MASK		(MMC_CAP_4_BIT_DATA | MMC_CAP_8_BIT_DATA)
+/* Mask of all UHS-I bus speed modes which need 1.8V signalling */
+#define MMC_CAP_UHS_MASK		(MMC_CAP_UHS_SDR50 | MMC_CAP_UHS_SDR104 | \
+					 MMC_CAP_UHS_DDR50)
 
 #define SD_DATA_4BIT		0x00040000
+#define SD_SCR_CMD23_SUPPORT	0x00000002
 
 #define IS_SD(x) (x->version & SD_VERSION_SD)
 
@@ -89,6 +99,9 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK	19
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
+#define MMC_CMD_SET_BLOCK_COUNT		23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
 #define MMC_CMD_APP_CMD			55
@@ -98,6 +111,7 @@
 #define SD_CMD_SEND_RELATIVE_ADDR	3
 #define SD_CMD_SWITCH_FUNC		6
 #define SD_CMD_SEND_IF_COND		8
+#define SD_CMD_SWITCH_UHS18V		11
 
 #define SD_CMD_APP_SET_BUS_WIDTH	6
 #define SD_CMD_APP_SEND_OP_COND		41
@@ -107,11 +121,23 @@
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
 
+/* UHS-I bus speed modes in the SD_CMD_SWITCH_FUNC status, function group 1 */
+#define SD_MODE_UHS_SDR50	(1 << 2)
+#define SD_MODE_UHS_SDR104	(1 << 3)
+#define SD_MODE_UHS_DDR50	(1 << 4)
+
+#define UHS_SDR25_BUS_SPEED	1
+#define UHS_SDR50_BUS_SPEED	2
+#define UHS_SDR104_BUS_SPEED	3
+#define UHS_DDR50_BUS_SPEED	4
+
 #define MMC_HS_TIMING		0x00000100
 
 #define OCR_BUSY		0x80000000
 /** card's response in its OCR if it is a high capacity card */
 #define OCR_HCS			0x40000000
+/** host requests (ACMD41) / card accepts (response) 1.8V signalling */
+#define OCR_S18R		0x01000000
 
 #define MMC_VDD_165_195		0x00000080	/* VDD voltage 1.65 - 1.95 */
 #define MMC_VDD_20_21		0x00000100	/* VDD voltage 2.0 ~ 2.1 */
@@ -293,7 +319,7 @@
 #define EXT_CSD_CMD_SET_SECURE		(1<<1)
 #define EXT_CSD_CMD_SET_CPSECURE	(1<<2)
 
-#define EXT_CSD_CARD_TYPE_MASK		0x3f
+#define EXT_CSD_CARD_TYPE_MASK		0xff
 #define EXT_CSD_CARD_TYPE_26		(1<<0)	/* Card can run at 26MHz */
 #define EXT_CSD_CARD_TYPE_52		(1<<1)	/* Card can run at 52MHz */
 #define EXT_CSD_CARD_TYPE_DDR_1_8V	(1<<2)	/* Card can run at 52MHz */
@@ -303,6 +329,8 @@
 #define EXT_CSD_CARD_TYPE_SDR_1_8V	(1<<4)	/* Card can run at 200MHz */
 #define EXT_CSD_CARD_TYPE_SDR_1_2V	(1<<5)	/* Card can run at 200MHz */
 						/* SDR mode @1.2V I/O */
+#define EXT_CSD_CARD_TYPE_HS400_1_8V	(1<<6)	/* Card can run at 200MHz DDR, 1.8V */
+#define EXT_CSD_CARD_TYPE_HS400_1_2V	(1<<7)	/* Card can run at 200MHz DDR, 1.2V */
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -310,6 +338,11 @@
 #define EXT_CSD_DDR_BUS_WIDTH_4	5	/* Card is in 4 bit DDR mode */
 #define EXT_CSD_DDR_BUS_WIDTH_8	6	/* Card is in 8 bit DDR mode */
 
+#define EXT_CSD_TIMING_BC	0	/* Backwards compatility */
+#define EXT_CSD_TIMING_HS	1	/* High speed */
+#define EXT_CSD_TIMING_HS200	2	/* HS200 */
+#define EXT_CSD_TIMING_HS400	3	/* HS400 */
+
 #define R1_ILLEGAL_COMMAND		(1 << 22)
 #define R1_APP_CMD			(1 << 5)
 
@@ -378,6 +411,7 @@ struct mci_ios {
 #define MMC_TIMING_UHS_SDR104	4
 #define MMC_TIMING_UHS_DDR50	5
 #define MMC_TIMING_MMC_HS200	6
+#define MMC_TIMING_MMC_HS400	7
 
 #define MMC_SDR_MODE		0
 #define MMC_1_2V_DDR_MODE	1
@@ -386,6 +420,9 @@ struct mci_ios {
 #define MMC_1_8V_SDR_MODE	4
 };
 
+#define MMC_SIGNAL_VOLTAGE_330	0
+#define MMC_SIGNAL_VOLTAGE_180	1
+
 struct mci;
 
 /** host information */
@@ -399,6 +436,8 @@ struct mci_host {
 	unsigned f_max;		/**< host interface upper limit */
 	unsigned clock;		/**< Current clock used to talk to the card */
 	unsigned bus_width;	/**< used data bus width to the card */
+	unsigned timing;	/**< used timing specification, refer MMC_TIMING_* */
+	unsigned signal_voltage; /**< used I/O voltage, refer MMC_SIGNAL_VOLTAGE_* */
 	unsigned max_req_size;
 	unsigned dsr_val;	/**< optional dsr value */
 	int use_dsr;		/**< optional dsr usage flag */
@@ -416,6 +455,18 @@ struct mci_host {
 	int (*card_present)(struct mci_host *);
 	/** check if a card is write protected */
 	int (*card_write_protected)(struct mci_host *);
+	/**
+	 * switch the I/O voltage. For SD cards this is called right after
+	 * the card accepted CMD11 and has to do the whole clock gating
+	 * sequence of the switch.
+	 */
+	int (*set_signal_voltage)(struct mci_host *, unsigned char voltage);
+	/**
+	 * find the sample point for the current timing. Implementations
+	 * typically step through their delay taps and probe each one with
+	 * mci_send_tuning(). Needed for HS200 and SDR50/SDR104.
+	 */
+	int (*execute_tuning)(struct mci_host *, u32 opcode);
 };
 
 #define MMC_NUM_BOOT_PARTITION	2
@@ -479,6 +530,7 @@ void mci_of_parse_node(struct mci_host *host, struct device_node *np);
 int mci_detect_card(struct mci_host *);
 int mci_send_ext_csd(struct mci *mci, char *ext_csd);
 int mci_switch(struct mci *mci, unsigned index, unsigned value);
+int mci_send_tuning(struct mci_host *host, u32 opcode);
 
 static inline int mmc_host_is_spi(struct mci_host *host)
 {
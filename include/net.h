@@ -28,7 +28,7 @@
 #define PKT_NUM_RETRIES 4
 
 /* The number of receive packet buffers */
-#define PKTBUFSRX	4
+#define PKTBUFSRX	32
 
 struct device_d;
 
@@ -39,10 +39,17 @@ struct eth_device {
 
 	int  (*open) (struct eth_device*);
 	int  (*send) (struct eth_device*, void *packet, int length);
+	/*
+	 * Receive and dispatch frames. Returns a positive value when a frame
+	 * was taken from the hardware, the core then calls it again to
+	 * drain the receive ring. 0 or a negative error code otherwise.
+	 */
 	int  (*recv) (struct eth_device*);
 	void (*halt) (struct eth_device*);
 	int  (*get_ethaddr) (struct eth_device*, u8 adr[6]);
 	int  (*set_ethaddr) (struct eth_device*, const unsigned char *adr);
+	/* Optional: pass all multicast frames, called on an opened device */
+	int  (*set_allmulti) (struct eth_device*, int enable);
 
 	struct eth_device *next;
 	void *priv;
@@ -68,8 +75,17 @@ struct eth_device {
 #define ETH_MODE_STATIC 1
 #define ETH_MODE_DISABLED 2
 	unsigned int global_mode;
+
+	/* Offloads the driver supports, ETH_FEATURE_* */
+	unsigned int features;
+
+	/* Number of users which need multicast frames */
+	int allmulti;
 };
 
+/* The hardware inserts the IPv4 header, TCP, UDP and ICMP checksums */
+#define ETH_FEATURE_TX_CSUM	(1 << 0)
+
 #define dev_to_edev(d) container_of(d, struct eth_device, dev)
 
 static inline const char *eth_name(struct eth_device *edev)
@@ -83,6 +99,9 @@ int eth_set_ethaddr(struct eth_device *edev, const char *ethaddr);
 
 int eth_send(struct eth_device *edev, void *packet, int length);	   /* Send a packet		*/
 int eth_rx(void);			/* Check for received packets	*/
+int eth_open(struct eth_device *edev);	/* Open without waiting for link */
+int eth_link_poll(struct eth_device *edev);	/* Open, check for link	*/
+void eth_set_allmulti(struct eth_device *edev, int enable);
 
 /* associate a MAC address to a ethernet device. Should be called by
  * board code for boards which store their MAC address at some unusual
@@ -117,10 +136,31 @@ struct ethernet {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_IGMP	 2	/* Internet Group Management Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 #define IP_BROADCAST    0xffffffff /* Broadcast IP aka 255.255.255.255 */
 
+/* 224.0.0.0/4, ip in network byte order */
+static inline int net_ip_is_multicast(IPaddr_t ip)
+{
+	return (ntohl(ip) & 0xf0000000) == 0xe0000000;
+}
+
+/* Ethernet address a multicast group is mapped to (RFC 1112) */
+static inline void net_ip_to_multicast_ether(IPaddr_t ip, u8 *ether)
+{
+	uint32_t group = ntohl(ip);
+
+	ether[0] = 0x01;
+	ether[1] = 0x00;
+	ether[2] = 0x5e;
+	ether[3] = (group >> 16) & 0x7f;
+	ether[4] = (group >> 8) & 0xff;
+	ether[5] = group & 0xff;
+}
+
 /*
  *	Internet Protocol (IP) header.
  */
@@ -145,6 +185,28 @@ struct udphdr {
 	uint16_t	uh_sum;		/* udp checksum */
 } __attribute__ ((packed));
 
+/*
+ *	Transmission Control Protocol (TCP) header.
+ */
+struct tcphdr {
+	uint16_t	source;		/* source port */
+	uint16_t	dest;		/* destination port */
+	uint32_t	seq;		/* sequence number */
+	uint32_t	ack_seq;	/* acknowledgement number */
+	uint8_t		doff;		/* header length in 32 bit words << 4 */
+	uint8_t		flags;
+	uint16_t	window;
+	uint16_t	check;
+	uint16_t	urg_ptr;
+	/* The options start here. */
+} __attribute__ ((packed));
+
+#define TCP_FLAG_FIN	0x01
+#define TCP_FLAG_SYN	0x02
+#define TCP_FLAG_RST	0x04
+#define TCP_FLAG_PSH	0x08
+#define TCP_FLAG_ACK	0x10
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -200,6 +262,20 @@ struct icmphdr {
 	} un;
 } __attribute__ ((packed));
 
+/*
+ *	Internet Group Management Protocol (IGMPv2) message.
+ */
+struct igmphdr {
+	uint8_t		type;
+	uint8_t		code;		/* max response time */
+	uint16_t	csum;
+	uint32_t	group;
+} __attribute__ ((packed));
+
+#define IGMP_HOST_MEMBERSHIP_QUERY	0x11
+#define IGMPV2_HOST_MEMBERSHIP_REPORT	0x16
+#define IGMP_HOST_LEAVE_MESSAGE		0x17
+
 
 /*
  * Maximum packet size; used to allocate packet storage.
@@ -221,17 +297,22 @@ struct icmphdr {
 
 extern unsigned char *NetRxPackets[PKTBUFSRX];/* Receive packets		*/
 
+/* Number of DNS servers that can be configured (like MAXNS in resolv.conf) */
+#define NET_MAX_NAMESERVERS	3
+
 void net_set_ip(struct eth_device *edev, IPaddr_t ip);
 void net_set_serverip(IPaddr_t ip);
 void net_set_serverip_empty(IPaddr_t ip);
 void net_set_netmask(struct eth_device *edev, IPaddr_t ip);
 void net_set_gateway(IPaddr_t ip);
 void net_set_nameserver(IPaddr_t ip);
+void net_set_nameservers(const IPaddr_t *ip, int num);
 void net_set_domainname(const char *name);
 IPaddr_t net_get_ip(struct eth_device *edev);
 IPaddr_t net_get_serverip(void);
 IPaddr_t net_get_gateway(void);
 IPaddr_t net_get_nameserver(void);
+int net_get_nameservers(IPaddr_t *ip, int max);
 const char *net_get_domainname(void);
 struct eth_device *net_route(IPaddr_t ip);
 
@@ -258,6 +339,11 @@ static inline char *net_eth_to_icmp_payload(char *pkt)
 	return (char *)(net_eth_to_icmphdr(pkt) + 1);
 }
 
+static inline struct tcphdr *net_eth_to_tcphdr(char *pkt)
+{
+	return (struct tcphdr *)(net_eth_to_iphdr(pkt) + 1);
+}
+
 static inline char *net_eth_to_udp_payload(char *pkt)
 {
 	return (char *)(net_eth_to_udphdr(pkt) + 1);
@@ -419,6 +505,7 @@ static inline int is_valid_ether_addr(const u8 *addr)
 typedef void rx_handler_f(void *ctx, char *packet, unsigned int len);
 
 struct eth_device *eth_get_byname(const char *name);
+struct eth_device *eth_get_first_configured(void);
 
 /**
  * net_receive - Pass a received packet from an ethernet driver to the protocol stack
@@ -429,12 +516,24 @@ struct eth_device *eth_get_byname(const char *name);
  */
 int net_receive(struct eth_device *edev, unsigned char *pkt, int len);
 
+/* Checksums of a received frame already verified by the hardware */
+#define NET_RX_CSUM_IP		(1 << 0)	/* IPv4 header */
+#define NET_RX_CSUM_L4		(1 << 1)	/* TCP/UDP payload */
+
+/**
+ * net_receive_csum - Like net_receive, for drivers with receive checksum offload
+ * @csum: NET_RX_CSUM_* flags for the checksums the hardware found to be correct
+ */
+int net_receive_csum(struct eth_device *edev, unsigned char *pkt, int len,
+		     unsigned int csum);
+
 struct net_connection {
 	struct ethernet *et;
 	struct iphdr *ip;
 	struct udphdr *udp;
 	struct eth_device *edev;
 	struct icmphdr *icmp;
+	struct tcphdr *tcp;
 	unsigned char *packet;
 	struct list_head list;
 	rx_handler_f *handler;
@@ -457,13 +556,12 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 		void *ctx);
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx);
+
 void net_unregister(struct net_connection *con);
 
-static inline int net_udp_bind(struct net_connection *con, uint16_t sport)
-{
-	con->udp->uh_sport = ntohs(sport);
-	return 0;
-}
+int net_udp_bind(struct net_connection *con, uint16_t sport);
 
 static inline void *net_udp_get_payload(struct net_connection *con)
 {
@@ -473,6 +571,40 @@ static inline void *net_udp_get_payload(struct net_connection *con)
 
 int net_udp_send(struct net_connection *con, int len);
 int net_icmp_send(struct net_connection *con, int len);
+int net_tcp_send(struct net_connection *con, int len);
+uint16_t net_tcp_checksum(struct iphdr *ip, int len);
+
+/*
+ * Destination a receiver registers for its payload while it polls. Data
+ * received in sequence is copied straight to its final location, only
+ * what does not fit goes to an overflow fifo.
+ */
+struct net_rx_dest {
+	void *buf;
+	size_t len;
+};
+
+struct kfifo;
+
+void net_rx_deliver(struct net_rx_dest *dest, struct kfifo *overflow,
+		    const void *data, size_t len);
+
+/*
+ * Multicast group membership. While joined, datagrams sent to the group
+ * are delivered like those to our own address.
+ */
+int net_mcast_join(struct eth_device *edev, IPaddr_t group);
+void net_mcast_leave(struct eth_device *edev, IPaddr_t group);
+
+/*
+ * Minimal TCP client, see net/tcp.c
+ */
+struct tcp_connection;
+
+struct tcp_connection *tcp_open(IPaddr_t dest, uint16_t dport);
+int tcp_write(struct tcp_connection *tc, const void *buf, size_t len);
+int tcp_read(struct tcp_connection *tc, void *buf, size_t len);
+void tcp_close(struct tcp_connection *tc);
 
 void led_trigger_network(enum led_trigger trigger);
 
@@ -563,6 +563,44 @@ out:
 	return -1;
 }
 
+/**
+ * open_for_write - open a file or device to write it from the start
+ * @filename:	The file to open, created if it does not exist
+ * @size:	The number of bytes that will be written, ERASE_SIZE_ALL if unknown
+ *
+ * Like cp, this truncates existing regular files only. Devices are erased
+ * for @size bytes instead, as flash has to be erased before it can be
+ * written. Devices which cannot be erased are written as they are.
+ *
+ * Return: A file descriptor or a negative error code
+ */
+int open_for_write(const char *filename, loff_t size)
+{
+	struct stat s;
+	int mode = O_WRONLY | O_CREAT;
+	int fd, ret, is_dev;
+
+	ret = stat(filename, &s);
+	is_dev = !ret && !S_ISREG(s.st_mode);
+	if (!ret && !is_dev)
+		mode |= O_TRUNC;
+
+	fd = open(filename, mode);
+	if (fd < 0)
+		return -errno;
+
+	if (is_dev) {
+		ret = erase(fd, size, 0);
+		if (ret && ret != -ENOSYS) {
+			close(fd);
+			return ret;
+		}
+	}
+
+	return fd;
+}
+EXPORT_SYMBOL(open_for_write);
+
 /**
  * make_temp - create a name for a temporary file
  * @template:	The filename prefix
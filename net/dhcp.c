@@ -74,12 +74,21 @@ typedef enum {
 
 #define DHCP_MIN_EXT_LEN 64	/* minimal length of extension list	*/
 
-static uint32_t Bootp_id;
-static dhcp_state_t dhcp_state;
-static uint64_t dhcp_start;
-static struct eth_device *dhcp_edev;
-struct dhcp_req_param dhcp_param;
-struct dhcp_result *dhcp_result;
+/* Retransmission timeouts, doubled on every retry */
+#define DHCP_TIMEOUT_MIN	SECOND
+#define DHCP_TIMEOUT_MAX	(4 * SECOND)
+
+/* State of the DHCP client on one interface */
+struct dhcp_ctx {
+	struct eth_device *edev;
+	struct net_connection *con;
+	dhcp_state_t state;
+	uint32_t xid;
+	uint64_t start;		/* time of the last transmission */
+	uint64_t timeout;	/* current retransmission timeout */
+	struct dhcp_req_param param;
+	struct dhcp_result *result;
+};
 
 struct dhcp_receivce_opts {
 	IPaddr_t netmask;
@@ -119,7 +128,8 @@ static int dhcp_set_ip_options(int option, u8 *e, IPaddr_t ip)
 	return 6;
 }
 
-static int bootp_check_packet(unsigned char *pkt, unsigned src, unsigned len)
+static int bootp_check_packet(struct dhcp_ctx *ctx, unsigned char *pkt,
+			      unsigned src, unsigned len)
 {
 	struct bootp *bp = (struct bootp *) pkt;
 	int retval = 0;
@@ -139,7 +149,7 @@ static int bootp_check_packet(unsigned char *pkt, unsigned src, unsigned len)
 		retval = -4;
 	else if (bp->bp_hlen != HWL_ETHER)
 		retval = -5;
-	else if (net_read_uint32(&bp->bp_id) != Bootp_id) {
+	else if (net_read_uint32(&bp->bp_id) != ctx->xid) {
 		retval = -6;
 	}
 
@@ -151,14 +161,15 @@ static int bootp_check_packet(unsigned char *pkt, unsigned src, unsigned len)
 /*
  * Copy parameters of interest from BOOTP_REPLY/DHCP_OFFER packet
  */
-static void bootp_copy_net_params(struct bootp *bp)
+static void bootp_copy_net_params(struct dhcp_ctx *ctx, struct bootp *bp)
 {
+	struct dhcp_result *res = ctx->result;
 
-	dhcp_result->ip = net_read_ip(&bp->bp_yiaddr);
-	dhcp_result->serverip = net_read_ip(&bp->bp_siaddr);
+	res->ip = net_read_ip(&bp->bp_yiaddr);
+	res->serverip = net_read_ip(&bp->bp_siaddr);
 
 	if (strlen(bp->bp_file) > 0)
-		dhcp_result->bootfile = xstrdup(bp->bp_file);
+		res->bootfile = xstrdup(bp->bp_file);
 }
 
 static int dhcp_set_string_options(int option, const char *str, u8 *e)
@@ -182,9 +193,10 @@ static int dhcp_set_string_options(int option, const char *str, u8 *e)
 /*
  * Initialize BOOTP extension fields in the request.
  */
-static int dhcp_extended(u8 *e, int message_type, IPaddr_t ServerID,
-			  IPaddr_t RequestedIP)
+static int dhcp_extended(struct dhcp_ctx *ctx, u8 *e, int message_type,
+			 IPaddr_t ServerID, IPaddr_t RequestedIP)
 {
+	struct dhcp_req_param *param = &ctx->param;
 	int i;
 	u8 *start = e;
 	u8 *cnt;
@@ -208,12 +220,12 @@ static int dhcp_extended(u8 *e, int message_type, IPaddr_t ServerID,
 	e += dhcp_set_ip_options(50, e, RequestedIP);
 	e += dhcp_set_ip_options(54, e, ServerID);
 
-	e += dhcp_set_string_options(DHCP_HOSTNAME, dhcp_param.hostname, e);
-	e += dhcp_set_string_options(DHCP_VENDOR_ID, dhcp_param.vendor_id, e);
-	e += dhcp_set_string_options(DHCP_CLIENT_ID, dhcp_param.client_id, e);
-	e += dhcp_set_string_options(DHCP_USER_CLASS, dhcp_param.user_class, e);
-	e += dhcp_set_string_options(DHCP_CLIENT_UUID, dhcp_param.client_uuid, e);
-	e += dhcp_set_string_options(DHCP_OPTION224, dhcp_param.option224, e);
+	e += dhcp_set_string_options(DHCP_HOSTNAME, param->hostname, e);
+	e += dhcp_set_string_options(DHCP_VENDOR_ID, param->vendor_id, e);
+	e += dhcp_set_string_options(DHCP_CLIENT_ID, param->client_id, e);
+	e += dhcp_set_string_options(DHCP_USER_CLASS, param->user_class, e);
+	e += dhcp_set_string_options(DHCP_CLIENT_UUID, param->client_uuid, e);
+	e += dhcp_set_string_options(DHCP_OPTION224, param->option224, e);
 
 	*e++ = 55;		/* Parameter Request List */
 	cnt = e++;		/* Pointer to count of requested items */
@@ -232,20 +244,18 @@ static int dhcp_extended(u8 *e, int message_type, IPaddr_t ServerID,
 	return e - start;
 }
 
-static struct net_connection *dhcp_con;
-
-static int bootp_request(void)
+static int bootp_request(struct dhcp_ctx *ctx)
 {
 	struct bootp *bp;
 	int ext_len;
 	int ret;
 	const char *bfile;
 
-	dhcp_state = INIT;
+	ctx->state = INIT;
 
 	debug("BOOTP broadcast\n");
 
-	bp = net_udp_get_payload(dhcp_con);;
+	bp = net_udp_get_payload(ctx->con);
 	bp->bp_op = OP_BOOTREQUEST;
 	bp->bp_htype = HWT_ETHER;
 	bp->bp_hlen = HWL_ETHER;
@@ -255,27 +265,29 @@ static int bootp_request(void)
 	net_write_ip(&bp->bp_yiaddr, 0);
 	net_write_ip(&bp->bp_siaddr, 0);
 	net_write_ip(&bp->bp_giaddr, 0);
-	memcpy(bp->bp_chaddr, dhcp_con->et->et_src, 6);
+	memcpy(bp->bp_chaddr, ctx->con->et->et_src, 6);
 
 	bfile = getenv("bootfile");
 	if (bfile)
 		safe_strncpy(bp->bp_file, bfile, sizeof(bp->bp_file));
 
 	/* Request additional information from the BOOTP/DHCP server */
-	ext_len = dhcp_extended(bp->bp_vend, DHCP_DISCOVER, 0, 0);
+	ext_len = dhcp_extended(ctx, bp->bp_vend, DHCP_DISCOVER, 0, 0);
 
-	Bootp_id = (uint32_t)get_time_ns();
-	net_copy_uint32(&bp->bp_id, &Bootp_id);
+	ctx->xid = (uint32_t)get_time_ns() ^ (uintptr_t)ctx->edev;
+	net_copy_uint32(&bp->bp_id, &ctx->xid);
 
-	dhcp_state = SELECTING;
+	ctx->state = SELECTING;
+	ctx->start = get_time_ns();
 
-	ret = net_udp_send(dhcp_con, sizeof(*bp) + ext_len);
+	ret = net_udp_send(ctx->con, sizeof(*bp) + ext_len);
 
 	return ret;
 }
 
-static void dhcp_options_handle(unsigned char option, void *popt,
-			       int optlen, struct bootp *bp)
+static void dhcp_options_handle(struct dhcp_result *dhcp_result,
+				unsigned char option, void *popt,
+				int optlen, struct bootp *bp)
 {
 	switch (option) {
 		case 1:
@@ -284,9 +296,13 @@ static void dhcp_options_handle(unsigned char option, void *popt,
 		case 3:
 			dhcp_result->gateway = net_read_ip(popt);
 			break;
-		case 6:
-			dhcp_result->nameserver = net_read_ip(popt);
+		case 6: {
+			int i;
+
+			for (i = 0; i < NET_MAX_NAMESERVERS && (i + 1) * 4 <= optlen; i++)
+				dhcp_result->nameserver[i] = net_read_ip(popt + i * 4);
 			break;
+		}
 		case DHCP_HOSTNAME:
 			dhcp_result->hostname = xstrndup(popt, optlen);
 			break;
@@ -317,7 +333,8 @@ static void dhcp_options_handle(unsigned char option, void *popt,
 	}
 }
 
-static void dhcp_options_process(unsigned char *popt, struct bootp *bp)
+static void dhcp_options_process(struct dhcp_ctx *ctx, unsigned char *popt,
+				 struct bootp *bp)
 {
 	unsigned char *end = popt + sizeof(*bp) + OPT_SIZE;
 	int oplen;
@@ -327,7 +344,7 @@ static void dhcp_options_process(unsigned char *popt, struct bootp *bp)
 		oplen = *(popt + 1);
 		option = *popt;
 
-		dhcp_options_handle(option, popt + 2, oplen, bp);
+		dhcp_options_handle(ctx->result, option, popt + 2, oplen, bp);
 
 		popt += oplen + 2;	/* Process next option */
 	}
@@ -347,14 +364,15 @@ static int dhcp_message_type(unsigned char *popt)
 	return -1;
 }
 
-static void dhcp_send_request_packet(struct bootp *bp_offer)
+static void dhcp_send_request_packet(struct dhcp_ctx *ctx,
+				     struct bootp *bp_offer)
 {
 	struct bootp *bp;
 	int extlen;
 
 	debug("%s: Sending DHCPREQUEST\n", __func__);
 
-	bp = net_udp_get_payload(dhcp_con);
+	bp = net_udp_get_payload(ctx->con);
 	bp->bp_op = OP_BOOTREQUEST;
 	bp->bp_htype = HWT_ETHER;
 	bp->bp_hlen = HWL_ETHER;
@@ -367,7 +385,7 @@ static void dhcp_send_request_packet(struct bootp *bp_offer)
 	 */
 	net_write_ip(&bp->bp_giaddr, 0);
 
-	memcpy(bp->bp_chaddr, dhcp_con->et->et_src, 6);
+	memcpy(bp->bp_chaddr, ctx->con->et->et_src, 6);
 
 	/*
 	 * ID is the id of the OFFER packet
@@ -378,18 +396,19 @@ static void dhcp_send_request_packet(struct bootp *bp_offer)
 	/*
 	 * Copy options from OFFER packet if present
 	 */
-	extlen = dhcp_extended(bp->bp_vend, DHCP_REQUEST,
-			dhcp_result->dhcp_serverip, dhcp_result->ip);
+	extlen = dhcp_extended(ctx, bp->bp_vend, DHCP_REQUEST,
+			ctx->result->dhcp_serverip, ctx->result->ip);
 
 	debug("Transmitting DHCPREQUEST packet\n");
-	net_udp_send(dhcp_con, sizeof(*bp) + extlen);
+	net_udp_send(ctx->con, sizeof(*bp) + extlen);
 }
 
 /*
  *	Handle DHCP received packets.
  */
-static void dhcp_handler(void *ctx, char *packet, unsigned int len)
+static void dhcp_handler(void *_ctx, char *packet, unsigned int len)
 {
+	struct dhcp_ctx *ctx = _ctx;
 	char *pkt = net_eth_to_udp_payload(packet);
 	struct udphdr *udp = net_eth_to_udphdr(packet);
 	struct bootp *bp = (struct bootp *)pkt;
@@ -397,12 +416,12 @@ static void dhcp_handler(void *ctx, char *packet, unsigned int len)
 	len = net_eth_to_udplen(packet);
 
 	debug("DHCPHandler: got packet: (len=%d) state: %d\n",
-		len, dhcp_state);
+		len, ctx->state);
 
-	if (bootp_check_packet(pkt, ntohs(udp->uh_sport), len)) /* Filter out pkts we don't want */
+	if (bootp_check_packet(ctx, pkt, ntohs(udp->uh_sport), len)) /* Filter out pkts we don't want */
 		return;
 
-	switch (dhcp_state) {
+	switch (ctx->state) {
 	case SELECTING:
 		/*
 		 * Wait an appropriate time for any potential DHCPOFFER packets
@@ -411,15 +430,15 @@ static void dhcp_handler(void *ctx, char *packet, unsigned int len)
 		 * OFFER from a server we want.
 		 */
 		debug("%s: state SELECTING, bp_file: \"%s\"\n", __func__, bp->bp_file);
-		dhcp_state = REQUESTING;
+		ctx->state = REQUESTING;
 
 		if (net_read_uint32(&bp->bp_vend[0]) == htonl(BOOTP_VENDOR_MAGIC))
-			dhcp_options_process((u8 *)&bp->bp_vend[4], bp);
+			dhcp_options_process(ctx, (u8 *)&bp->bp_vend[4], bp);
 
-		bootp_copy_net_params(bp); /* Store net params from reply */
+		bootp_copy_net_params(ctx, bp); /* Store net params from reply */
 
-		dhcp_start = get_time_ns();
-		dhcp_send_request_packet(bp);
+		ctx->start = get_time_ns();
+		dhcp_send_request_packet(ctx, bp);
 
 		break;
 	case REQUESTING:
@@ -427,10 +446,10 @@ static void dhcp_handler(void *ctx, char *packet, unsigned int len)
 
 		if (dhcp_message_type((u8 *)bp->bp_vend) == DHCP_ACK ) {
 			if (net_read_uint32(&bp->bp_vend[0]) == htonl(BOOTP_VENDOR_MAGIC))
-				dhcp_options_process(&bp->bp_vend[4], bp);
-			bootp_copy_net_params(bp); /* Store net params from reply */
-			dhcp_state = BOUND;
-			dev_info(&dhcp_edev->dev, "DHCP client bound to address %pI4\n", &dhcp_result->ip);
+				dhcp_options_process(ctx, &bp->bp_vend[4], bp);
+			bootp_copy_net_params(ctx, bp); /* Store net params from reply */
+			ctx->state = BOUND;
+			dev_info(&ctx->edev->dev, "DHCP client bound to address %pI4\n", &ctx->result->ip);
 			return;
 		}
 		break;
@@ -461,68 +480,166 @@ static void set_res(char **var, const char *res)
 		*var = xstrdup("");
 }
 
-int dhcp_request(struct eth_device *edev, const struct dhcp_req_param *param,
-		 struct dhcp_result **res)
+static int dhcp_ctx_init(struct dhcp_ctx *ctx, struct eth_device *edev,
+			 const struct dhcp_req_param *param)
 {
-	int ret = 0;
+	int ret;
 
-	dhcp_edev = edev;
+	ctx->edev = edev;
 	if (param)
-		dhcp_param = *param;
-	else
-		memset(&dhcp_param, 0, sizeof(dhcp_param));
-
-	dhcp_result = xzalloc(sizeof(*dhcp_result));
-
-	if (!dhcp_param.user_class)
-		dhcp_param.user_class = global_dhcp_user_class;
-	if (!dhcp_param.vendor_id)
-		dhcp_param.vendor_id = global_dhcp_vendor_id;
-	if (!dhcp_param.client_uuid)
-		dhcp_param.client_uuid = global_dhcp_client_uuid;
-	if (!dhcp_param.client_id)
-		dhcp_param.client_id = global_dhcp_client_id;
-	if (!dhcp_param.option224)
-		dhcp_param.option224 = global_dhcp_option224;
-	if (!dhcp_param.retries)
-		dhcp_param.retries = global_dhcp_retries;
-
-	dhcp_con = net_udp_eth_new(edev, IP_BROADCAST, PORT_BOOTPS, dhcp_handler, NULL);
-	if (IS_ERR(dhcp_con)) {
-		ret = PTR_ERR(dhcp_con);
-		goto out;
+		ctx->param = *param;
+
+	if (!ctx->param.user_class)
+		ctx->param.user_class = global_dhcp_user_class;
+	if (!ctx->param.vendor_id)
+		ctx->param.vendor_id = global_dhcp_vendor_id;
+	if (!ctx->param.client_uuid)
+		ctx->param.client_uuid = global_dhcp_client_uuid;
+	if (!ctx->param.client_id)
+		ctx->param.client_id = global_dhcp_client_id;
+	if (!ctx->param.option224)
+		ctx->param.option224 = global_dhcp_option224;
+	if (!ctx->param.retries)
+		ctx->param.retries = global_dhcp_retries;
+
+	ctx->con = net_udp_eth_new(edev, IP_BROADCAST, PORT_BOOTPS, dhcp_handler, ctx);
+	if (IS_ERR(ctx->con)) {
+		ret = PTR_ERR(ctx->con);
+		ctx->con = NULL;
+		return ret;
 	}
 
-	ret = net_udp_bind(dhcp_con, PORT_BOOTPC);
-	if (ret)
-		goto out1;
+	ret = net_udp_bind(ctx->con, PORT_BOOTPC);
+	if (ret) {
+		net_unregister(ctx->con);
+		ctx->con = NULL;
+		return ret;
+	}
+
+	ctx->result = xzalloc(sizeof(*ctx->result));
+	ctx->state = INIT;
+	ctx->start = get_time_ns();
 
 	net_set_ip(edev, 0);
 
-	dhcp_start = get_time_ns();
-	ret = bootp_request(); /* Basically same as BOOTP */
+	return 0;
+}
+
+static void dhcp_ctx_exit(struct dhcp_ctx *ctx)
+{
+	if (ctx->con)
+		net_unregister(ctx->con);
+	if (ctx->result)
+		dhcp_result_free(ctx->result);
+}
+
+/*
+ * Advance the DHCP client on one interface without blocking. Returns
+ * -EAGAIN while the client is still busy, 0 once it is bound or a negative
+ * error code if it failed.
+ */
+static int dhcp_ctx_poll(struct dhcp_ctx *ctx)
+{
+	int ret;
+
+	switch (ctx->state) {
+	case BOUND:
+		return 0;
+	case INIT:
+		/* Nothing sent yet, wait for the link to come up */
+		ret = eth_link_poll(ctx->edev);
+		if (ret == -ENETDOWN) {
+			if (is_timeout(ctx->start, PHY_AN_TIMEOUT * SECOND))
+				return -ENETDOWN;
+			return -EAGAIN;
+		}
+		if (ret)
+			return ret;
+
+		ctx->timeout = DHCP_TIMEOUT_MIN;
+		break;
+	default:
+		if (!is_timeout(ctx->start, ctx->timeout))
+			return -EAGAIN;
+		if (!ctx->param.retries)
+			return -ETIMEDOUT;
+
+		printf("T ");
+		ctx->param.retries--;
+		ctx->timeout = min_t(uint64_t, ctx->timeout * 2, DHCP_TIMEOUT_MAX);
+		break;
+	}
+
+	ret = bootp_request(ctx); /* Basically same as BOOTP */
 	if (ret)
-		goto out1;
+		return ret;
+
+	return -EAGAIN;
+}
 
-	while (dhcp_state != BOUND) {
+/**
+ * dhcp_request_any - run DHCP on several interfaces at once
+ * @edevs: the interfaces
+ * @num: number of interfaces in @edevs
+ * @param: request parameters, may be NULL
+ * @bound: returns the interface which got the lease, may be NULL
+ * @res: returns the lease
+ *
+ * The interfaces are brought up concurrently, the first one that gets a
+ * lease wins and DHCP is stopped on the others.
+ */
+int dhcp_request_any(struct eth_device **edevs, int num,
+		     const struct dhcp_req_param *param,
+		     struct eth_device **bound, struct dhcp_result **res)
+{
+	struct dhcp_ctx *ctxs, *ctx = NULL;
+	int i, ret, busy;
+
+	ctxs = xzalloc(num * sizeof(*ctxs));
+
+	ret = -ENODEV;
+	for (i = 0; i < num; i++) {
+		ret = dhcp_ctx_init(&ctxs[i], edevs[i], param);
+		if (ret)
+			debug("%s: dhcp failed: %s\n", eth_name(edevs[i]),
+			      strerror(-ret));
+	}
+
+	do {
 		if (ctrlc()) {
 			ret = -EINTR;
-			goto out1;
-		}
-		if (!dhcp_param.retries) {
-			ret = -ETIMEDOUT;
-			goto out1;
+			goto out;
 		}
+
 		net_poll();
-		if (is_timeout(dhcp_start, 3 * SECOND)) {
-			dhcp_start = get_time_ns();
-			printf("T ");
-			ret = bootp_request();
-			/* no need to check if retries > 0 as we check if != 0 */
-			dhcp_param.retries--;
-			if (ret)
-				goto out1;
+
+		busy = 0;
+		for (i = 0; i < num; i++) {
+			if (!ctxs[i].con)
+				continue;
+
+			ret = dhcp_ctx_poll(&ctxs[i]);
+			if (!ret) {
+				ctx = &ctxs[i];
+				break;
+			}
+
+			if (ret == -EAGAIN) {
+				busy = 1;
+				continue;
+			}
+
+			/* Give up on this interface, keep going on the others */
+			debug("%s: dhcp failed: %s\n", eth_name(edevs[i]), strerror(-ret));
+			net_unregister(ctxs[i].con);
+			ctxs[i].con = NULL;
 		}
+	} while (!ctx && busy);
+
+	if (!ctx) {
+		if (!ret || ret == -EAGAIN)
+			ret = -ETIMEDOUT;
+		goto out;
 	}
 
 	pr_debug("DHCP result:\n"
@@ -536,30 +653,40 @@ int dhcp_request(struct eth_device *edev, const struct dhcp_req_param *param,
 		"  rootpath: %s\n"
 		"  devicetree: %s\n"
 		"  tftp_server_name: %s\n",
-		&dhcp_result->ip,
-		&dhcp_result->netmask,
-		&dhcp_result->gateway,
-		&dhcp_result->serverip,
-		&dhcp_result->nameserver,
-		dhcp_result->hostname ? dhcp_result->hostname : "",
-		dhcp_result->domainname ? dhcp_result->domainname : "",
-		dhcp_result->rootpath ? dhcp_result->rootpath : "",
-		dhcp_result->devicetree ? dhcp_result->devicetree : "",
-		dhcp_result->tftp_server_name ? dhcp_result->tftp_server_name : "");
-
-out1:
-	net_unregister(dhcp_con);
+		&ctx->result->ip,
+		&ctx->result->netmask,
+		&ctx->result->gateway,
+		&ctx->result->serverip,
+		&ctx->result->nameserver[0],
+		ctx->result->hostname ? ctx->result->hostname : "",
+		ctx->result->domainname ? ctx->result->domainname : "",
+		ctx->result->rootpath ? ctx->result->rootpath : "",
+		ctx->result->devicetree ? ctx->result->devicetree : "",
+		ctx->result->tftp_server_name ? ctx->result->tftp_server_name : "");
+
+	*res = ctx->result;
+	ctx->result = NULL;
+	if (bound)
+		*bound = ctx->edev;
+	ret = 0;
 out:
-	if (ret) {
+	if (ret)
 		debug("dhcp failed: %s\n", strerror(-ret));
-		free(dhcp_result);
-	} else {
-		*res = dhcp_result;
-	}
+
+	for (i = 0; i < num; i++)
+		dhcp_ctx_exit(&ctxs[i]);
+
+	free(ctxs);
 
 	return ret;
 }
 
+int dhcp_request(struct eth_device *edev, const struct dhcp_req_param *param,
+		 struct dhcp_result **res)
+{
+	return dhcp_request_any(&edev, 1, param, NULL, res);
+}
+
 int dhcp_set_result(struct eth_device *edev, struct dhcp_result *res)
 {
 	int ret;
@@ -567,7 +694,7 @@ int dhcp_set_result(struct eth_device *edev, struct dhcp_result *res)
 	net_set_ip(edev, res->ip);
 	net_set_netmask(edev, res->netmask);
 	net_set_gateway(res->gateway);
-	net_set_nameserver(res->nameserver);
+	net_set_nameservers(res->nameserver, NET_MAX_NAMESERVERS);
 
 	set_res(&global_dhcp_bootfile, res->bootfile);
 	set_res(&global_dhcp_oftree_file, res->devicetree);
@@ -604,12 +731,14 @@ void dhcp_result_free(struct dhcp_result *res)
 	free(res);
 }
 
-int dhcp(struct eth_device *edev, const struct dhcp_req_param *param)
+int dhcp_any(struct eth_device **edevs, int num,
+	     const struct dhcp_req_param *param, struct eth_device **bound)
 {
 	struct dhcp_result *res;
+	struct eth_device *edev;
 	int ret;
 
-	ret = dhcp_request(edev, param, &res);
+	ret = dhcp_request_any(edevs, num, param, &edev, &res);
 	if (ret)
 		return ret;
 
@@ -620,9 +749,17 @@ int dhcp(struct eth_device *edev, const struct dhcp_req_param *param)
 	if (!ret)
 		edev->ifup = true;
 
+	if (bound)
+		*bound = edev;
+
 	return ret;
 }
 
+int dhcp(struct eth_device *edev, const struct dhcp_req_param *param)
+{
+	return dhcp_any(&edev, 1, param, NULL);
+}
+
 #ifdef CONFIG_GLOBALVAR
 
 static int dhcp_global_init(void)
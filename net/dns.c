@@ -29,6 +29,10 @@
 #include <net.h>
 #include <clock.h>
 #include <environment.h>
+#include <globalvar.h>
+#include <magicvar.h>
+#include <init.h>
+#include <stdlib.h>
 #include <linux/err.h>
 
 #define DNS_PORT 53
@@ -56,35 +60,125 @@ struct header {
 #define STATE_INIT	0
 #define STATE_DONE	1
 
-static struct net_connection *dns_con;
-static uint64_t dns_timer_start;
+/* Upper bound for the time an answer is kept, regardless of its TTL */
+#define DNS_CACHE_TTL_MAX	86400
+#define DNS_CACHE_SIZE		8
+
+struct dns_cache_entry {
+	char *name;
+	IPaddr_t ip;
+	uint64_t expire;
+};
+
+static struct dns_cache_entry dns_cache[DNS_CACHE_SIZE];
+static int dns_cache_hits;
+static int dns_cache_misses;
+
+/*
+ * One outstanding query per nameserver. All nameservers are asked at the
+ * same time and the first positive answer wins.
+ */
+struct dns_query {
+	struct net_connection *con;
+	int state;
+};
+
+static uint16_t dns_tid;
 static int dns_state;
 static IPaddr_t dns_ip;
+static uint32_t dns_ttl;
+
+static int dns_cache_lookup(const char *name, IPaddr_t *ip)
+{
+	uint64_t now = get_time_ns();
+	int i;
+
+	for (i = 0; i < DNS_CACHE_SIZE; i++) {
+		struct dns_cache_entry *e = &dns_cache[i];
+
+		if (!e->name || strcmp(e->name, name))
+			continue;
+
+		if (now >= e->expire)
+			return -ENOENT;
+
+		*ip = e->ip;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+static struct dns_cache_entry *dns_cache_slot(const char *name, uint64_t now)
+{
+	struct dns_cache_entry *e, *victim = &dns_cache[0];
+	int i;
+
+	for (i = 0; i < DNS_CACHE_SIZE; i++) {
+		e = &dns_cache[i];
+		if (e->name && !strcmp(e->name, name))
+			return e;
+	}
+
+	/* an empty or expired slot, else the entry which expires first */
+	for (i = 0; i < DNS_CACHE_SIZE; i++) {
+		e = &dns_cache[i];
+		if (!e->name || now >= e->expire)
+			return e;
+		if (e->expire < victim->expire)
+			victim = e;
+	}
+
+	return victim;
+}
+
+static void dns_cache_add(const char *name, IPaddr_t ip, uint32_t ttl)
+{
+	uint64_t now = get_time_ns();
+	struct dns_cache_entry *e;
+
+	if (!ttl)
+		return;
+
+	e = dns_cache_slot(name, now);
+
+	if (!e->name || strcmp(e->name, name)) {
+		free(e->name);
+		e->name = xstrdup(name);
+	}
+
+	e->ip = ip;
+	e->expire = now + (uint64_t)min_t(uint32_t, ttl, DNS_CACHE_TTL_MAX) * SECOND;
+}
 
-static int dns_send(const char *name)
+static char *dns_fullname(const char *name)
+{
+	const char *domain = getenv("global.net.domainname");
+
+	if (!strchr(name, '.') && domain && *domain)
+		return basprintf("%s.%s", name, domain);
+	else
+		return xstrdup(name);
+}
+
+static int dns_send(struct net_connection *con, const char *name)
 {
 	int ret;
 	struct header *header;
 	enum dns_query_type qtype = DNS_A_RECORD;
-	unsigned char *packet = net_udp_get_payload(dns_con);
+	unsigned char *packet = net_udp_get_payload(con);
 	unsigned char *p, *s, *fullname, *dotptr;
-	const unsigned char *domain;
 
 	/* Prepare DNS packet header */
 	header           = (struct header *)packet;
-	header->tid      = 1;
+	header->tid      = dns_tid;
 	header->flags    = htons(0x100);	/* standard query */
 	header->nqueries = htons(1);		/* Just one query */
 	header->nanswers = 0;
 	header->nauth    = 0;
 	header->nother   = 0;
 
-	domain = getenv("global.net.domainname");
-
-	if (!strchr(name, '.') && domain && *domain)
-		fullname = basprintf(".%s.%s.", name, domain);
-	else
-		fullname = basprintf(".%s.", name);
+	fullname = basprintf(".%s.", name);
 
 	/* replace dots in fullname with chunk len */
 	dotptr = fullname;
@@ -111,29 +205,36 @@ static int dns_send(const char *name)
 	*p++ = 0;
 	*p++ = 1;				/* Class: inet, 0x0001 */
 
-	ret = net_udp_send(dns_con, p - packet);
+	ret = net_udp_send(con, p - packet);
 
 	free(fullname);
 
 	return ret;
 }
 
-static void dns_recv(struct header *header, unsigned len)
+static void dns_recv(struct dns_query *query, struct header *header,
+		     unsigned len)
 {
 	unsigned char *p, *e, *s;
 	u16 type;
+	u32 ttl;
 	int found, stop, dlen;
 	short tmp;
 
 	pr_debug("%s\n", __func__);
 
+	/* Late answer to a previous query or already answered */
+	if (len < sizeof(*header) || header->tid != dns_tid ||
+	    query->state == STATE_DONE || dns_state == STATE_DONE)
+		return;
+
 	/* We sent 1 query. We want to see more that 1 answer. */
 	if (ntohs(header->nqueries) != 1)
 		return;
 
 	/* Received 0 answers */
 	if (header->nanswers == 0) {
-		dns_state = STATE_DONE;
+		query->state = STATE_DONE;
 		pr_debug("DNS server returned no answers\n");
 		return;
 	}
@@ -168,6 +269,12 @@ static void dns_recv(struct header *header, unsigned len)
 		tmp = p[2] | (p[3] << 8);
 		type = ntohs(tmp);
 		pr_debug("type = %d\n", type);
+
+		/* the answer lives no longer than any record of the chain */
+		ttl = (p[6] << 24) | (p[7] << 16) | (p[8] << 8) | p[9];
+		if (type == DNS_CNAME_RECORD || type == DNS_A_RECORD)
+			dns_ttl = min(dns_ttl, ttl);
+
 		if (type == DNS_CNAME_RECORD) {
 			/* CNAME answer. shift to the next section */
 			debug("Found canonical name\n");
@@ -176,7 +283,7 @@ static void dns_recv(struct header *header, unsigned len)
 			pr_debug("dlen = %d\n", dlen);
 			p += 12 + dlen;
 		} else if (type == DNS_A_RECORD) {
-			pr_debug("Found A-record\n");
+			pr_debug("Found A-record, ttl %u\n", ttl);
 			found = stop = 1;
 		} else {
 			pr_debug("Unknown type\n");
@@ -192,66 +299,128 @@ static void dns_recv(struct header *header, unsigned len)
 		dns_ip = net_read_ip(p);
 		dns_state = STATE_DONE;
 	}
+
+	query->state = STATE_DONE;
 }
 
 static void dns_handler(void *ctx, char *packet, unsigned len)
 {
-	(void)ctx;
-	dns_recv((struct header *)net_eth_to_udp_payload(packet),
+	dns_recv(ctx, (struct header *)net_eth_to_udp_payload(packet),
 		net_eth_to_udplen(packet));
 }
 
 int resolv(const char *host, IPaddr_t *ip)
 {
-	IPaddr_t nameserver;
+	IPaddr_t nameserver[NET_MAX_NAMESERVERS];
+	struct dns_query query[NET_MAX_NAMESERVERS];
+	uint64_t dns_timer_start;
+	char *name;
+	int i, num, pending, sent = 0, ret = 0;
 
 	if (!string_to_ip(host, ip))
 		return 0;
 
-	dns_ip = 0;
 	*ip = 0;
 
-	dns_state = STATE_INIT;
+	name = dns_fullname(host);
+
+	if (!dns_cache_lookup(name, ip)) {
+		dns_cache_hits++;
+		pr_debug("host %s is at %pI4 (cached)\n", name, ip);
+		free(name);
+		return 0;
+	}
+
+	dns_cache_misses++;
 
-	nameserver = net_get_nameserver();
-	if (!nameserver) {
+	num = net_get_nameservers(nameserver, NET_MAX_NAMESERVERS);
+	if (!num) {
 		pr_err("no nameserver specified in $net.nameserver\n");
+		free(name);
 		return 0;
 	}
 
-	pr_debug("resolving host %s via nameserver %pI4\n", host, &nameserver);
+	dns_ip = 0;
+	dns_ttl = DNS_CACHE_TTL_MAX;
+	dns_tid = random32();
+	dns_state = STATE_INIT;
+
+	for (i = 0; i < num; i++) {
+		pr_debug("resolving host %s via nameserver %pI4\n", name,
+			 &nameserver[i]);
+
+		query[i].state = STATE_INIT;
+		query[i].con = net_udp_new(nameserver[i], DNS_PORT,
+					   dns_handler, &query[i]);
+		if (IS_ERR(query[i].con)) {
+			ret = PTR_ERR(query[i].con);
+			query[i].con = NULL;
+			query[i].state = STATE_DONE;
+			continue;
+		}
+
+		dns_send(query[i].con, name);
+		sent++;
+	}
 
-	dns_con = net_udp_new(nameserver, DNS_PORT, dns_handler, NULL);
-	if (IS_ERR(dns_con))
-		return PTR_ERR(dns_con);
 	dns_timer_start = get_time_ns();
-	dns_send(host);
 
 	while (dns_state != STATE_DONE) {
 		if (ctrlc()) {
 			break;
 		}
 		net_poll();
+
+		for (i = pending = 0; i < num; i++)
+			if (query[i].state != STATE_DONE)
+				pending++;
+		if (!pending)
+			break;
+
 		if (is_timeout(dns_timer_start, SECOND)) {
 			dns_timer_start = get_time_ns();
 			printf("T ");
-			dns_send(host);
+			for (i = 0; i < num; i++)
+				if (query[i].state != STATE_DONE)
+					dns_send(query[i].con, name);
 		}
 	}
 
-	net_unregister(dns_con);
+	for (i = 0; i < num; i++)
+		if (query[i].con)
+			net_unregister(query[i].con);
 
 	if (dns_ip) {
-		pr_debug("host %s is at %pI4\n", host, &dns_ip);
+		pr_debug("host %s is at %pI4, ttl %u\n", name, &dns_ip, dns_ttl);
+		dns_cache_add(name, dns_ip, dns_ttl);
+		*ip = dns_ip;
+		ret = 0;
 	} else {
-		pr_debug("host %s not found\n", host);
-		return -ENOENT;
+		pr_debug("host %s not found\n", name);
+		/* report why no query went out, otherwise the name is unknown */
+		if (sent)
+			ret = -ENOENT;
 	}
 
-	*ip = dns_ip;
+	free(name);
+
+	return ret;
+}
+
+static int dns_init(void)
+{
+	globalvar_add_simple_int("net.dns_cache_hits", &dns_cache_hits, "%d");
+	globalvar_add_simple_int("net.dns_cache_misses", &dns_cache_misses,
+				 "%d");
 
 	return 0;
 }
+device_initcall(dns_init);
+
+BAREBOX_MAGICVAR_NAMED(global_net_dns_cache_hits, global.net.dns_cache_hits,
+		       "Number of host names resolved from the DNS cache");
+BAREBOX_MAGICVAR_NAMED(global_net_dns_cache_misses, global.net.dns_cache_misses,
+		       "Number of host names that needed a DNS query");
 
 #ifdef CONFIG_CMD_HOST
 static int do_host(int argc, char *argv[])
@@ -166,6 +166,21 @@ struct eth_device *eth_get_byname(const char *ethname)
 	return NULL;
 }
 
+/*
+ * The first interface with an IP address. Services which wait for
+ * requests instead of routing to a peer listen on this one.
+ */
+struct eth_device *eth_get_first_configured(void)
+{
+	struct eth_device *edev;
+
+	for_each_netdev(edev) {
+		if (edev->ipaddr)
+			return edev;
+	}
+	return NULL;
+}
+
 #ifdef CONFIG_AUTO_COMPLETE
 int eth_complete(struct string_list *sl, char *instr)
 {
@@ -212,10 +227,10 @@ static int eth_carrier_check(struct eth_device *edev, int force)
 }
 
 /*
- * Check if we have a current ethernet device and
- * eventually open it if we have to.
+ * Open the device unless it is active already. Unlike eth_check_open()
+ * this does not wait for the link, so it can be used to start listening.
  */
-static int eth_check_open(struct eth_device *edev)
+int eth_open(struct eth_device *edev)
 {
 	int ret;
 
@@ -228,9 +243,61 @@ static int eth_check_open(struct eth_device *edev)
 
 	edev->active = 1;
 
+	if (edev->allmulti && edev->set_allmulti)
+		edev->set_allmulti(edev, 1);
+
+	return 0;
+}
+
+/*
+ * Check if we have a current ethernet device and
+ * eventually open it if we have to.
+ */
+static int eth_check_open(struct eth_device *edev)
+{
+	int ret;
+
+	if (edev->active)
+		return 0;
+
+	ret = eth_open(edev);
+	if (ret)
+		return ret;
+
 	return eth_carrier_check(edev, 1);
 }
 
+/*
+ * Open the device if necessary, but unlike eth_send() do not wait for
+ * autonegotiation. Returns -ENETDOWN as long as there is no link.
+ */
+int eth_link_poll(struct eth_device *edev)
+{
+	int ret;
+
+	ret = eth_open(edev);
+	if (ret)
+		return ret;
+
+	return eth_carrier_check(edev, 0);
+}
+
+/*
+ * Reference counted request to receive all multicast frames. Devices
+ * which are not open yet are configured when they are opened.
+ */
+void eth_set_allmulti(struct eth_device *edev, int enable)
+{
+	int old = edev->allmulti;
+
+	edev->allmulti += enable ? 1 : -1;
+
+	if (!edev->set_allmulti || !edev->active || !old == !edev->allmulti)
+		return;
+
+	edev->set_allmulti(edev, edev->allmulti > 0);
+}
+
 int eth_send(struct eth_device *edev, void *packet, int length)
 {
 	int ret;
@@ -248,9 +315,15 @@ int eth_send(struct eth_device *edev, void *packet, int length)
 	return edev->send(edev, packet, length);
 }
 
+/*
+ * Upper limit for the number of recv() calls per device and poll, so that
+ * a flood of packets on one interface cannot starve the caller.
+ */
+#define ETH_RX_BUDGET	64
+
 static int __eth_rx(struct eth_device *edev)
 {
-	int ret;
+	int ret, budget = ETH_RX_BUDGET;
 
 	ret = eth_check_open(edev);
 	if (ret)
@@ -260,7 +333,15 @@ static int __eth_rx(struct eth_device *edev)
 	if (ret)
 		return ret;
 
-	return edev->recv(edev);
+	/*
+	 * Drain the receive ring: drivers return a positive value as long
+	 * as they took a frame from the hardware.
+	 */
+	do {
+		ret = edev->recv(edev);
+	} while (ret > 0 && --budget);
+
+	return ret;
 }
 
 int eth_rx(void)
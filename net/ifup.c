@@ -192,7 +192,11 @@ static void set_linux_bootarg(struct eth_device *edev)
 	}
 }
 
-int ifup_edev(struct eth_device *edev, unsigned flags)
+/*
+ * Returns 1 if the interface has to be brought up, 0 if there is nothing
+ * to do or a negative error code.
+ */
+static int ifup_edev_prepare(struct eth_device *edev, unsigned flags)
 {
 	int ret;
 
@@ -214,20 +218,37 @@ int ifup_edev(struct eth_device *edev, unsigned flags)
 	if (ret)
 		return ret;
 
-	if (edev->global_mode == ETH_MODE_DHCP) {
-		if (IS_ENABLED(CONFIG_NET_DHCP)) {
-			ret = dhcp(edev, NULL);
-		} else {
-			dev_err(&edev->dev, "DHCP support not available\n");
-			ret = -ENOSYS;
-		}
-		if (ret)
-			return ret;
+	if (edev->global_mode == ETH_MODE_DHCP && !IS_ENABLED(CONFIG_NET_DHCP)) {
+		dev_err(&edev->dev, "DHCP support not available\n");
+		return -ENOSYS;
 	}
 
+	return 1;
+}
+
+static void ifup_edev_finish(struct eth_device *edev)
+{
 	set_linux_bootarg(edev);
 
 	edev->ifup = true;
+}
+
+int ifup_edev(struct eth_device *edev, unsigned flags)
+{
+	int ret;
+
+	ret = ifup_edev_prepare(edev, flags);
+	if (ret <= 0)
+		return ret;
+
+	if (IS_ENABLED(CONFIG_NET_DHCP) &&
+	    edev->global_mode == ETH_MODE_DHCP) {
+		ret = dhcp(edev, NULL);
+		if (ret)
+			return ret;
+	}
+
+	ifup_edev_finish(edev);
 
 	return 0;
 }
@@ -252,9 +273,10 @@ static int net_ifup_force_detect;
 
 int ifup_all(unsigned flags)
 {
-	struct eth_device *edev;
+	struct eth_device *edev, **dhcp_edevs;
 	DIR *dir;
 	struct dirent *d;
+	int num = 0;
 
 	dir = opendir("/env/network");
 	if (dir) {
@@ -276,7 +298,31 @@ int ifup_all(unsigned flags)
 		device_detect_all();
 
 	for_each_netdev(edev)
-		ifup_edev(edev, flags);
+		num++;
+
+	dhcp_edevs = xzalloc(num * sizeof(*dhcp_edevs));
+	num = 0;
+
+	for_each_netdev(edev) {
+		if (ifup_edev_prepare(edev, flags) <= 0)
+			continue;
+
+		if (edev->global_mode == ETH_MODE_DHCP)
+			dhcp_edevs[num++] = edev;
+		else
+			ifup_edev_finish(edev);
+	}
+
+	/*
+	 * Run DHCP on all interfaces at once instead of waiting for link
+	 * and lease timeouts one interface after the other. The first one
+	 * to get a lease is used.
+	 */
+	if (IS_ENABLED(CONFIG_NET_DHCP) && num &&
+	    !dhcp_any(dhcp_edevs, num, NULL, &edev))
+		ifup_edev_finish(edev);
+
+	free(dhcp_edevs);
 
 	return 0;
 }
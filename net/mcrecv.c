@@ -0,0 +1,504 @@
+/*
+ * mcrecv.c - receive a file sent to a multicast group
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A sender transmits a file once to a multicast group and any number of
+ * receivers pick it up at the same time. The protocol is a simple
+ * NACK based one in the spirit of UFTP and MTFTP. All packets start with
+ * struct mcrecv_hdr, integers are in network byte order:
+ *
+ * DATA    sender to group      one block of the file at block * blocksize
+ * STATUS  sender to group      end of a pass over the file; receivers
+ *                              answer with NACK or DONE
+ * NACK    receiver to sender   list of missing blocks as struct
+ *                              mcrecv_range, the sender resends them
+ *                              in its next pass
+ * DONE    receiver to sender   all blocks received
+ *
+ * The session number and file size come with every packet, so receivers
+ * can join a transfer which is already running; blocks they missed are
+ * repaired in the following passes.
+ */
+
+#define pr_fmt(fmt) "mcrecv: " fmt
+
+#include <common.h>
+#include <command.h>
+#include <complete.h>
+#include <net.h>
+#include <clock.h>
+#include <fs.h>
+#include <errno.h>
+#include <libfile.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <linux/bitmap.h>
+#include <linux/list.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+#include <asm-generic/div64.h>
+
+#define MCRECV_PORT		1758
+#define MCRECV_VERSION		1
+
+#define MCRECV_DATA		1
+#define MCRECV_STATUS		2
+#define MCRECV_NACK		3
+#define MCRECV_DONE		4
+
+struct mcrecv_hdr {
+	uint8_t		opcode;
+	uint8_t		version;
+	uint16_t	blocksize;
+	uint32_t	session;
+	uint64_t	size;		/* file size in bytes */
+	uint32_t	block;		/* DATA only */
+} __attribute__ ((packed));
+
+struct mcrecv_range {
+	uint32_t	first;
+	uint32_t	num;
+} __attribute__ ((packed));
+
+#define MCRECV_MAX_PAYLOAD	(PKTSIZE - ETHER_HDR_SIZE - \
+				 sizeof(struct iphdr) - sizeof(struct udphdr))
+#define MCRECV_MAX_RANGES	((MCRECV_MAX_PAYLOAD - \
+				  sizeof(struct mcrecv_hdr)) / \
+				 sizeof(struct mcrecv_range))
+
+/* Ask for the missing blocks after this time without packets */
+#define MCRECV_IDLE_TIMEOUT	(2 * SECOND)
+
+/*
+ * Blocks kept while the destination is opened. A burst drained from the
+ * receive ring in one poll fits, whatever comes later is NACKed.
+ */
+#define MCRECV_MAX_BACKLOG	64
+
+enum mcrecv_state {
+	MCRECV_WAIT,		/* waiting for the first packet of a session */
+	MCRECV_SETUP,		/* session known, destination not opened yet */
+	MCRECV_RUN,		/* receiving */
+	MCRECV_FINISHED,	/* all blocks received */
+};
+
+/* A block received before the destination was opened */
+struct mcrecv_block {
+	struct list_head list;
+	uint32_t block;
+	int len;
+	char data[];
+};
+
+struct mcrecv {
+	enum mcrecv_state state;
+	struct eth_device *edev;
+	struct net_connection *con;	/* group traffic */
+	struct net_connection *reply;	/* to the sender */
+
+	IPaddr_t sender_ip;
+	uint16_t sender_port;
+	uint32_t session;
+	int blocksize;
+	uint64_t size;
+	uint32_t nblocks;
+
+	unsigned long *received;	/* bitmap of blocks written */
+	uint32_t nreceived;
+	uint64_t bytes;
+	int fd;
+	int err;
+
+	struct list_head backlog;	/* struct mcrecv_block */
+	int nbacklog;
+
+	int nack_pending;
+	uint64_t last_activity;
+	int idle;			/* timeouts without packets */
+};
+
+static void mcrecv_fill_hdr(struct mcrecv *mr, struct mcrecv_hdr *hdr,
+			    int opcode)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->opcode = opcode;
+	hdr->version = MCRECV_VERSION;
+	hdr->blocksize = htons(mr->blocksize);
+	hdr->session = htonl(mr->session);
+	hdr->size = cpu_to_be64(mr->size);
+}
+
+/*
+ * Report the missing blocks, as many ranges as fit into one packet
+ * starting with the first block missing. The remaining ones are reported
+ * after the next pass.
+ */
+static void mcrecv_send_nack(struct mcrecv *mr)
+{
+	struct mcrecv_hdr *hdr = net_udp_get_payload(mr->reply);
+	struct mcrecv_range *range = (struct mcrecv_range *)(hdr + 1);
+	unsigned long first, last = 0;
+	int n = 0;
+
+	mcrecv_fill_hdr(mr, hdr, MCRECV_NACK);
+
+	while (n < MCRECV_MAX_RANGES) {
+		first = find_next_zero_bit(mr->received, mr->nblocks, last);
+		if (first >= mr->nblocks)
+			break;
+
+		last = find_next_bit(mr->received, mr->nblocks, first);
+
+		range[n].first = htonl(first);
+		range[n].num = htonl(last - first);
+		n++;
+	}
+
+	pr_debug("NACK with %d ranges, %u of %u blocks received\n", n,
+		 mr->nreceived, mr->nblocks);
+
+	net_udp_send(mr->reply, sizeof(*hdr) + n * sizeof(*range));
+
+	mr->nack_pending = 0;
+}
+
+static void mcrecv_send_done(struct mcrecv *mr)
+{
+	struct mcrecv_hdr *hdr = net_udp_get_payload(mr->reply);
+
+	mcrecv_fill_hdr(mr, hdr, MCRECV_DONE);
+
+	net_udp_send(mr->reply, sizeof(*hdr));
+}
+
+static void mcrecv_data(struct mcrecv *mr, uint32_t block, void *data,
+			int len)
+{
+	uint64_t offset = (uint64_t)block * mr->blocksize;
+	int ret;
+
+	if (block >= mr->nblocks || test_bit(block, mr->received))
+		return;
+
+	/* Only the last block may be short */
+	if (len != min_t(uint64_t, mr->blocksize, mr->size - offset))
+		return;
+
+	ret = pwrite(mr->fd, data, len, offset);
+	if (ret != len) {
+		mr->err = ret < 0 ? ret : -ENOSPC;
+		mr->state = MCRECV_FINISHED;
+		return;
+	}
+
+	__set_bit(block, mr->received);
+	mr->nreceived++;
+
+	if (mr->bytes / SZ_1M != (mr->bytes + len) / SZ_1M)
+		putchar('#');
+	mr->bytes += len;
+
+	if (mr->nreceived == mr->nblocks)
+		mr->state = MCRECV_FINISHED;
+}
+
+static void mcrecv_defer_data(struct mcrecv *mr, uint32_t block, void *data,
+			      int len)
+{
+	struct mcrecv_block *b;
+
+	if (mr->nbacklog == MCRECV_MAX_BACKLOG)
+		return;
+
+	b = malloc(sizeof(*b) + len);
+	if (!b)
+		return;
+
+	b->block = block;
+	b->len = len;
+	memcpy(b->data, data, len);
+	list_add_tail(&b->list, &mr->backlog);
+	mr->nbacklog++;
+}
+
+/* Write the deferred blocks once the destination is open, or drop them */
+static void mcrecv_flush_backlog(struct mcrecv *mr)
+{
+	struct mcrecv_block *b, *tmp;
+
+	list_for_each_entry_safe(b, tmp, &mr->backlog, list) {
+		if (mr->state == MCRECV_RUN)
+			mcrecv_data(mr, b->block, b->data, b->len);
+		list_del(&b->list);
+		free(b);
+	}
+
+	mr->nbacklog = 0;
+}
+
+static void mcrecv_handler(void *ctx, char *packet, unsigned len)
+{
+	struct mcrecv *mr = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(packet);
+	struct udphdr *udp = net_eth_to_udphdr(packet);
+	struct mcrecv_hdr *hdr = (struct mcrecv_hdr *)net_eth_to_udp_payload(packet);
+	int plen = net_eth_to_udplen(packet);
+
+	if (plen < sizeof(*hdr) || hdr->version != MCRECV_VERSION)
+		return;
+
+	if (hdr->opcode != MCRECV_DATA && hdr->opcode != MCRECV_STATUS)
+		return;
+
+	if (mr->state == MCRECV_WAIT) {
+		if (!hdr->blocksize || !hdr->size)
+			return;
+
+		mr->sender_ip = net_read_ip(&ip->saddr);
+		mr->sender_port = ntohs(udp->uh_sport);
+		mr->session = ntohl(hdr->session);
+		mr->blocksize = ntohs(hdr->blocksize);
+		mr->size = be64_to_cpu(hdr->size);
+		mr->state = MCRECV_SETUP;
+	}
+
+	if (ntohl(hdr->session) != mr->session ||
+	    net_read_ip(&ip->saddr) != mr->sender_ip)
+		return;
+
+	if (mr->state != MCRECV_SETUP && mr->state != MCRECV_RUN)
+		return;
+
+	mr->last_activity = get_time_ns();
+	mr->idle = 0;
+
+	if (hdr->opcode == MCRECV_STATUS)
+		mr->nack_pending = 1;
+	else if (mr->state == MCRECV_SETUP)
+		mcrecv_defer_data(mr, ntohl(hdr->block), hdr + 1,
+				  plen - sizeof(*hdr));
+	else
+		mcrecv_data(mr, ntohl(hdr->block), hdr + 1,
+			    plen - sizeof(*hdr));
+}
+
+static int mcrecv_start(struct mcrecv *mr, const char *dest)
+{
+	int ret;
+	uint64_t nblocks;
+
+	nblocks = DIV_ROUND_UP_ULL(mr->size, mr->blocksize);
+	if (nblocks > U32_MAX)
+		return -EFBIG;
+	mr->nblocks = nblocks;
+
+	mr->reply = net_udp_eth_new(mr->edev, mr->sender_ip, mr->sender_port,
+				    mcrecv_handler, mr);
+	if (IS_ERR(mr->reply)) {
+		ret = PTR_ERR(mr->reply);
+		mr->reply = NULL;
+		return ret;
+	}
+
+	mr->fd = open_for_write(dest, mr->size);
+	if (mr->fd < 0) {
+		ret = mr->fd;
+		pr_err("could not open %s: %s\n", dest, strerror(-ret));
+		goto out;
+	}
+
+	mr->received = xzalloc(BITS_TO_LONGS(mr->nblocks) *
+			       sizeof(unsigned long));
+	mr->nreceived = 0;
+	mr->bytes = 0;
+	mr->last_activity = get_time_ns();
+	mr->state = MCRECV_RUN;
+
+	printf("receiving session %u from %pI4, %llu bytes to %s\n",
+	       mr->session, &mr->sender_ip, mr->size, dest);
+
+	mcrecv_flush_backlog(mr);
+
+	return 0;
+out:
+	net_unregister(mr->reply);
+	mr->reply = NULL;
+
+	return ret;
+}
+
+static int do_mcrecv(int argc, char *argv[])
+{
+	struct mcrecv *mr;
+	struct eth_device *edev = NULL;
+	IPaddr_t group;
+	const char *dest;
+	int opt, port = MCRECV_PORT, timeout = 30, ret;
+
+	while ((opt = getopt(argc, argv, "i:p:t:")) > 0) {
+		switch (opt) {
+		case 'i':
+			edev = eth_get_byname(optarg);
+			if (!edev) {
+				printf("no such interface: %s\n", optarg);
+				return COMMAND_ERROR;
+			}
+			break;
+		case 'p':
+			port = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			timeout = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind + 2 != argc)
+		return COMMAND_ERROR_USAGE;
+
+	if (string_to_ip(argv[optind], &group) || !net_ip_is_multicast(group)) {
+		printf("invalid multicast group: %s\n", argv[optind]);
+		return COMMAND_ERROR_USAGE;
+	}
+
+	dest = argv[optind + 1];
+
+	/* NACKs need a source address, use the first configured interface */
+	if (!edev) {
+		edev = eth_get_first_configured();
+		if (!edev) {
+			printf("no configured network interface\n");
+			return COMMAND_ERROR;
+		}
+	}
+
+	/* Without it the driver may keep filtering the group's frames */
+	if (!edev->set_allmulti)
+		pr_warn("%s has no multicast filter control, group traffic may be dropped\n",
+			eth_name(edev));
+
+	mr = xzalloc(sizeof(*mr));
+	mr->edev = edev;
+	INIT_LIST_HEAD(&mr->backlog);
+
+	mr->con = net_udp_eth_new(edev, IP_BROADCAST, 0, mcrecv_handler, mr);
+	if (IS_ERR(mr->con)) {
+		ret = PTR_ERR(mr->con);
+		goto out;
+	}
+
+	net_udp_bind(mr->con, port);
+
+	ret = net_mcast_join(edev, group);
+	if (ret)
+		goto out_unregister;
+
+	printf("waiting for data on %pI4:%d, ctrl-c to stop\n", &group, port);
+
+	mr->last_activity = get_time_ns();
+
+	while (mr->state != MCRECV_FINISHED) {
+		if (ctrlc()) {
+			mr->err = -EINTR;
+			break;
+		}
+
+		net_poll();
+
+		switch (mr->state) {
+		case MCRECV_WAIT:
+			if (timeout && is_timeout(mr->last_activity,
+						  (uint64_t)timeout * SECOND)) {
+				mr->err = -ETIMEDOUT;
+				mr->state = MCRECV_FINISHED;
+			}
+			break;
+		case MCRECV_FINISHED:
+			break;
+		case MCRECV_SETUP:
+			ret = mcrecv_start(mr, dest);
+			if (ret) {
+				mr->err = ret;
+				mr->state = MCRECV_FINISHED;
+			}
+			break;
+		case MCRECV_RUN:
+			if (mr->nack_pending) {
+				mcrecv_send_nack(mr);
+				break;
+			}
+
+			if (!is_timeout(mr->last_activity, MCRECV_IDLE_TIMEOUT))
+				break;
+
+			if (timeout && ++mr->idle * MCRECV_IDLE_TIMEOUT >
+			    (uint64_t)timeout * SECOND) {
+				mr->err = -ETIMEDOUT;
+				mr->state = MCRECV_FINISHED;
+				break;
+			}
+
+			/* The sender may wait for us, tell it what is missing */
+			mr->last_activity = get_time_ns();
+			mcrecv_send_nack(mr);
+			break;
+		}
+	}
+
+	if (mr->reply) {
+		if (!mr->err)
+			mcrecv_send_done(mr);
+
+		if (close(mr->fd) && !mr->err)
+			mr->err = -errno;
+
+		net_unregister(mr->reply);
+	}
+
+	ret = mr->err;
+	if (ret)
+		printf("\nreceive failed: %s\n", strerror(-ret));
+	else
+		printf("\nreceived %llu bytes\n", mr->size);
+
+	net_mcast_leave(edev, group);
+out_unregister:
+	net_unregister(mr->con);
+out:
+	mcrecv_flush_backlog(mr);
+	free(mr->received);
+	free(mr);
+
+	return ret ? COMMAND_ERROR : COMMAND_SUCCESS;
+}
+
+BAREBOX_CMD_HELP_START(mcrecv)
+BAREBOX_CMD_HELP_TEXT("Join the multicast GROUP and write the file sent to it to DEST.")
+BAREBOX_CMD_HELP_TEXT("Blocks lost on the way are requested again from the sender, so")
+BAREBOX_CMD_HELP_TEXT("any number of boards can receive the same transmission. DEST can")
+BAREBOX_CMD_HELP_TEXT("be a file or a device, devices are erased before they are written.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-i ETH", "interface to use (default: first configured one)")
+BAREBOX_CMD_HELP_OPT ("-p PORT", "UDP port (default 1758)")
+BAREBOX_CMD_HELP_OPT ("-t SECONDS", "give up after SECONDS without data, 0 for never (default 30)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(mcrecv)
+	.cmd		= do_mcrecv,
+	BAREBOX_CMD_DESC("receive a file from a multicast group")
+	BAREBOX_CMD_OPTS("[-ipt] GROUP DEST")
+	BAREBOX_CMD_GROUP(CMD_GRP_NET)
+	BAREBOX_CMD_HELP(cmd_mcrecv_help)
+	BAREBOX_CMD_COMPLETE(empty_complete)
+BAREBOX_CMD_END
@@ -34,6 +34,7 @@
 #include <net.h>
 #include <driver.h>
 #include <errno.h>
+#include <kfifo.h>
 #include <malloc.h>
 #include <init.h>
 #include <globalvar.h>
@@ -46,17 +47,43 @@ static unsigned int net_ip_id;
 
 char *net_server;
 IPaddr_t net_gateway;
-static IPaddr_t net_nameserver;
+static IPaddr_t net_nameserver[NET_MAX_NAMESERVERS];
 static char *net_domainname;
 
 void net_set_nameserver(IPaddr_t nameserver)
 {
-	net_nameserver = nameserver;
+	net_nameserver[0] = nameserver;
+}
+
+/*
+ * Replace the whole list of nameservers, unused slots are cleared.
+ */
+void net_set_nameservers(const IPaddr_t *nameserver, int num)
+{
+	int i;
+
+	for (i = 0; i < NET_MAX_NAMESERVERS; i++)
+		net_nameserver[i] = i < num ? nameserver[i] : 0;
 }
 
 IPaddr_t net_get_nameserver(void)
 {
-	return net_nameserver;
+	return net_nameserver[0];
+}
+
+/*
+ * Fill @nameserver with the configured nameservers, skipping empty slots.
+ * Returns the number of nameservers stored.
+ */
+int net_get_nameservers(IPaddr_t *nameserver, int max)
+{
+	int i, num = 0;
+
+	for (i = 0; i < NET_MAX_NAMESERVERS && num < max; i++)
+		if (net_nameserver[i])
+			nameserver[num++] = net_nameserver[i];
+
+	return num;
 }
 
 void net_set_domainname(const char *name)
@@ -80,7 +107,7 @@ int net_checksum_ok(unsigned char *ptr, int len)
 
 uint16_t net_checksum(unsigned char *ptr, int len)
 {
-	uint32_t xsum = 0;
+	uint64_t xsum = 0;
 	uint16_t *p = (uint16_t *)ptr;
 
 	if (len & 1)
@@ -88,12 +115,31 @@ uint16_t net_checksum(unsigned char *ptr, int len)
 
 	len = (len + 1) >> 1;
 
+	if (((unsigned long)p & 2) && len) {
+		xsum += *p++;
+		len--;
+	}
+
+	/*
+	 * Summing up 32bit words gives the same ones complement sum as
+	 * summing up their 16bit halves, at half the number of loads.
+	 */
+	if (!((unsigned long)p & 3)) {
+		uint32_t *p32 = (uint32_t *)p;
+
+		for (; len >= 2; len -= 2)
+			xsum += *p32++;
+
+		p = (uint16_t *)p32;
+	}
+
 	while (len-- > 0)
 		xsum += *p++;
 
-	xsum = (xsum & 0xffff) + (xsum >> 16);
-	xsum = (xsum & 0xffff) + (xsum >> 16);
-	return xsum & 0xffff;
+	while (xsum >> 16)
+		xsum = (xsum & 0xffff) + (xsum >> 16);
+
+	return xsum;
 }
 
 IPaddr_t getenv_ip(const char *name)
@@ -123,27 +169,76 @@ int setenv_ip(const char *name, IPaddr_t ip)
 	return 0;
 }
 
-static unsigned char *arp_ether;
-static IPaddr_t arp_wait_ip;
+/*
+ * ARP neighbour cache, shared by all connections. Entries are created from
+ * ARP packets addressed to us and refreshed by any ARP packet of their
+ * owner, gratuitous ARP included. An entry not refreshed for
+ * ARP_CACHE_TIMEOUT has to be resolved again.
+ */
+#define ARP_CACHE_SIZE		8
+#define ARP_CACHE_TIMEOUT	(60 * SECOND)
+
+struct arp_entry {
+	struct eth_device *edev;
+	IPaddr_t ip;
+	unsigned char ether[6];
+	uint64_t time;
+};
+
+static struct arp_entry arp_cache[ARP_CACHE_SIZE];
 
-static void arp_handler(struct arprequest *arp)
+static struct arp_entry *arp_cache_find(struct eth_device *edev, IPaddr_t ip)
 {
-	IPaddr_t tmp;
+	int i;
 
-	/* are we waiting for a reply */
-	if (!arp_wait_ip)
-		return;
+	for (i = 0; i < ARP_CACHE_SIZE; i++) {
+		struct arp_entry *e = &arp_cache[i];
 
-	tmp = net_read_ip(&arp->ar_data[6]);
+		if (e->ip != ip || e->edev != edev)
+			continue;
 
-	/* matched waiting packet's address */
-	if (tmp == arp_wait_ip) {
-		/* save address for later use */
-		memcpy(arp_ether, &arp->ar_data[0], 6);
+		if (is_timeout(e->time, ARP_CACHE_TIMEOUT)) {
+			e->ip = 0;
+			return NULL;
+		}
 
-		/* no arp request pending now */
-		arp_wait_ip = 0;
+		return e;
 	}
+
+	return NULL;
+}
+
+static void arp_cache_update(struct eth_device *edev, IPaddr_t ip,
+			     const unsigned char *ether, int create)
+{
+	struct arp_entry *e;
+	int i;
+
+	if (!ip || !is_valid_ether_addr(ether))
+		return;
+
+	e = arp_cache_find(edev, ip);
+	if (!e) {
+		if (!create)
+			return;
+
+		/* Use a free entry or replace the oldest one */
+		e = &arp_cache[0];
+		for (i = 0; i < ARP_CACHE_SIZE; i++) {
+			if (!arp_cache[i].ip) {
+				e = &arp_cache[i];
+				break;
+			}
+			if (arp_cache[i].time < e->time)
+				e = &arp_cache[i];
+		}
+
+		e->edev = edev;
+		e->ip = ip;
+	}
+
+	memcpy(e->ether, ether, 6);
+	e->time = get_time_ns();
 }
 
 struct eth_device *net_route(IPaddr_t dest)
@@ -174,12 +269,24 @@ static int arp_request(struct eth_device *edev, IPaddr_t dest, unsigned char *et
 	uint64_t arp_start;
 	static char *arp_packet;
 	struct ethernet *et;
+	struct arp_entry *e;
+	IPaddr_t ip;
 	unsigned retries = 0;
 	int ret;
 
 	if (!edev)
 		return -EHOSTUNREACH;
 
+	if ((dest & edev->netmask) != (edev->ipaddr & edev->netmask) &&
+	    net_gateway)
+		ip = net_gateway;
+	else
+		ip = dest;
+
+	e = arp_cache_find(edev, ip);
+	if (e)
+		goto out;
+
 	if (!arp_packet) {
 		arp_packet = net_alloc_packet();
 		if (!arp_packet)
@@ -189,9 +296,7 @@ static int arp_request(struct eth_device *edev, IPaddr_t dest, unsigned char *et
 	pkt = arp_packet;
 	et = (struct ethernet *)arp_packet;
 
-	arp_wait_ip = dest;
-
-	pr_debug("send ARP broadcast for %pI4\n", &dest);
+	pr_debug("send ARP broadcast for %pI4\n", &ip);
 
 	memset(et->et_dest, 0xff, 6);
 	memcpy(et->et_src, edev->ethaddr, 6);
@@ -208,26 +313,14 @@ static int arp_request(struct eth_device *edev, IPaddr_t dest, unsigned char *et
 	memcpy(arp->ar_data, edev->ethaddr, 6);	/* source ET addr	*/
 	net_write_ip(arp->ar_data + 6, edev->ipaddr);	/* source IP addr	*/
 	memset(arp->ar_data + 10, 0, 6);	/* dest ET addr = 0     */
-
-	if ((dest & edev->netmask) != (edev->ipaddr & edev->netmask)) {
-		if (!net_gateway)
-			arp_wait_ip = dest;
-		else
-			arp_wait_ip = net_gateway;
-	} else {
-		arp_wait_ip = dest;
-	}
-
-	net_write_ip(arp->ar_data + 16, arp_wait_ip);
-
-	arp_ether = ether;
+	net_write_ip(arp->ar_data + 16, ip);	/* dest IP addr		*/
 
 	ret = eth_send(edev, arp_packet, ETHER_HDR_SIZE + ARP_HDR_SIZE);
 	if (ret)
 		return ret;
 	arp_start = get_time_ns();
 
-	while (arp_wait_ip) {
+	while (!(e = arp_cache_find(edev, ip))) {
 		if (ctrlc())
 			return -EINTR;
 
@@ -246,6 +339,9 @@ static int arp_request(struct eth_device *edev, IPaddr_t dest, unsigned char *et
 		net_poll();
 	}
 
+out:
+	memcpy(ether, e->ether, 6);
+
 	pr_debug("Got ARP REPLY for %pI4: %02x:%02x:%02x:%02x:%02x:%02x\n",
 		 &dest, ether[0], ether[1], ether[2], ether[3], ether[4],
 		 ether[5]);
@@ -321,7 +417,18 @@ IPaddr_t net_get_gateway(void)
 	return net_gateway;
 }
 
-static LIST_HEAD(connection_list);
+/*
+ * Connections are hashed by their local port for receive demultiplexing.
+ * ICMP connections have no port and are all kept in the bucket of port 0.
+ */
+#define NET_CON_HASH_SIZE	16
+
+static struct list_head connection_hash[NET_CON_HASH_SIZE];
+
+static struct list_head *net_con_bucket(uint16_t port)
+{
+	return &connection_hash[port & (NET_CON_HASH_SIZE - 1)];
+}
 
 static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 				      rx_handler_f *handler, void *ctx)
@@ -359,10 +466,13 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	con->ip = (struct iphdr *)(con->packet + ETHER_HDR_SIZE);
 	con->udp = (struct udphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->icmp = (struct icmphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
+	con->tcp = (struct tcphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
 	con->handler = handler;
 
 	if (dest == IP_BROADCAST) {
 		memset(con->et->et_dest, 0xff, 6);
+	} else if (net_ip_is_multicast(dest)) {
+		net_ip_to_multicast_ether(dest, con->et->et_dest);
 	} else {
 		ret = arp_request(edev, dest, con->et->et_dest);
 		if (ret)
@@ -375,12 +485,11 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	con->ip->hl_v = 0x45;
 	con->ip->tos = 0;
 	con->ip->frag_off = htons(0x4000);	/* No fragmentation */;
-	con->ip->ttl = 255;
+	/* multicast stays on the local network */
+	con->ip->ttl = net_ip_is_multicast(dest) ? 1 : 255;
 	net_copy_ip(&con->ip->daddr, &dest);
 	net_copy_ip(&con->ip->saddr, &edev->ipaddr);
 
-	list_add_tail(&con->list, &connection_list);
-
 	return con;
 out:
 	free(con->packet);
@@ -402,6 +511,8 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 	con->udp->uh_sport = htons(net_udp_new_localport());
 	con->ip->protocol = IPPROTO_UDP;
 
+	list_add_tail(&con->list, net_con_bucket(ntohs(con->udp->uh_sport)));
+
 	return con;
 }
 
@@ -422,9 +533,37 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 	con->proto = IPPROTO_ICMP;
 	con->ip->protocol = IPPROTO_ICMP;
 
+	list_add_tail(&con->list, net_con_bucket(0));
+
 	return con;
 }
 
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx)
+{
+	struct net_connection *con = net_new(NULL, dest, handler, ctx);
+
+	if (IS_ERR(con))
+		return con;
+
+	con->proto = IPPROTO_TCP;
+	con->tcp->dest = htons(dport);
+	con->tcp->source = htons(net_udp_new_localport());
+	con->ip->protocol = IPPROTO_TCP;
+
+	list_add_tail(&con->list, net_con_bucket(ntohs(con->tcp->source)));
+
+	return con;
+}
+
+int net_udp_bind(struct net_connection *con, uint16_t sport)
+{
+	con->udp->uh_sport = htons(sport);
+	list_move_tail(&con->list, net_con_bucket(sport));
+
+	return 0;
+}
+
 void net_unregister(struct net_connection *con)
 {
 	list_del(&con->list);
@@ -437,7 +576,9 @@ static int net_ip_send(struct net_connection *con, int len)
 	con->ip->tot_len = htons(sizeof(struct iphdr) + len);
 	con->ip->id = htons(net_ip_id++);
 	con->ip->check = 0;
-	con->ip->check = ~net_checksum((unsigned char *)con->ip, sizeof(struct iphdr));
+	if (!(con->edev->features & ETH_FEATURE_TX_CSUM))
+		con->ip->check = ~net_checksum((unsigned char *)con->ip,
+					       sizeof(struct iphdr));
 
 	return eth_send(con->edev, con->packet, ETHER_HDR_SIZE + sizeof(struct iphdr) + len);
 }
@@ -450,10 +591,68 @@ int net_udp_send(struct net_connection *con, int len)
 	return net_ip_send(con, sizeof(struct udphdr) + len);
 }
 
+/*
+ * net_rx_deliver - hand over received payload to its destination. As much
+ * as fits is copied to dest, which is advanced accordingly, the rest is
+ * queued in overflow.
+ */
+void net_rx_deliver(struct net_rx_dest *dest, struct kfifo *overflow,
+		    const void *data, size_t len)
+{
+	size_t now = min(len, dest->len);
+
+	memcpy(dest->buf, data, now);
+	dest->buf += now;
+	dest->len -= now;
+
+	if (len > now)
+		kfifo_put(overflow, data + now, len - now);
+}
+
+/*
+ * net_tcp_checksum - ones complement sum over the TCP segment behind ip,
+ * including the pseudo header. len is the length of the segment.
+ */
+uint16_t net_tcp_checksum(struct iphdr *ip, int len)
+{
+	struct {
+		uint32_t saddr;
+		uint32_t daddr;
+		uint8_t zero;
+		uint8_t protocol;
+		uint16_t len;
+	} __attribute__ ((packed)) ph;
+	uint32_t xsum;
+
+	net_copy_ip(&ph.saddr, &ip->saddr);
+	net_copy_ip(&ph.daddr, &ip->daddr);
+	ph.zero = 0;
+	ph.protocol = IPPROTO_TCP;
+	ph.len = htons(len);
+
+	xsum = net_checksum((unsigned char *)&ph, sizeof(ph));
+	xsum += net_checksum((unsigned char *)(ip + 1), len);
+	xsum = (xsum & 0xffff) + (xsum >> 16);
+
+	return xsum;
+}
+
+int net_tcp_send(struct net_connection *con, int len)
+{
+	con->tcp->check = 0;
+	if (!(con->edev->features & ETH_FEATURE_TX_CSUM))
+		con->tcp->check = ~net_tcp_checksum(con->ip, len);
+
+	return net_ip_send(con, len);
+}
+
 int net_icmp_send(struct net_connection *con, int len)
 {
-	con->icmp->checksum = ~net_checksum((unsigned char *)con->icmp,
-			sizeof(struct icmphdr) + len);
+	if (con->edev->features & ETH_FEATURE_TX_CSUM)
+		con->icmp->checksum = 0;
+	else
+		con->icmp->checksum = ~net_checksum((unsigned char *)con->icmp,
+				sizeof(struct icmphdr) + len);
 
 	return net_ip_send(con, sizeof(struct icmphdr) + len);
 }
@@ -501,6 +700,7 @@ static void net_bad_packet(unsigned char *pkt, int len)
 static int net_handle_arp(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct arprequest *arp;
+	IPaddr_t tip;
 
 	pr_debug("%s: got arp\n", __func__);
 
@@ -509,9 +709,9 @@ static int net_handle_arp(struct eth_device *edev, unsigned char *pkt, int len)
 	 * - REQUEST packets will be answered by sending  our
 	 *   IP address - if we know it.
 	 * - REPLY packets are expected only after we asked
-	 *   for the TFTP server's or the gateway's ethernet
-	 *   address; so if we receive such a packet, we set
-	 *   the server ethernet address
+	 *   for the server's or the gateway's ethernet address,
+	 *   arp_request() picks the address up from the cache.
+	 * Both update the ARP cache entry of the sender.
 	 */
 	arp = (struct arprequest *)(pkt + ETHER_HDR_SIZE);
 	if (len < ARP_HDR_SIZE)
@@ -526,14 +726,23 @@ static int net_handle_arp(struct eth_device *edev, unsigned char *pkt, int len)
 		goto bad;
 	if (edev->ipaddr == 0)
 		return 0;
-	if (net_read_ip(&arp->ar_data[16]) != edev->ipaddr)
+
+	tip = net_read_ip(&arp->ar_data[16]);
+
+	/*
+	 * Refresh a known sender in any case, this catches gratuitous
+	 * ARP. Senders talking to us are added to the cache.
+	 */
+	arp_cache_update(edev, net_read_ip(&arp->ar_data[6]), &arp->ar_data[0],
+			 tip == edev->ipaddr);
+
+	if (tip != edev->ipaddr)
 		return 0;
 
 	switch (ntohs(arp->ar_op)) {
 	case ARPOP_REQUEST:
 		return net_answer_arp(edev, pkt, len);
 	case ARPOP_REPLY:
-		arp_handler(arp);
 		return 1;
 	default:
 		pr_debug("Unexpected ARP opcode 0x%x\n", ntohs(arp->ar_op));
@@ -547,17 +756,57 @@ bad:
 	return -EINVAL;
 }
 
-static int net_handle_udp(unsigned char *pkt, int len)
+/*
+ * Several connections may be bound to the same port on different interfaces,
+ * like the DHCP clients during a parallel bring-up. Prefer the one on the
+ * interface the packet came in on, if edev is known.
+ */
+static int net_handle_udp(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
-	struct net_connection *con;
+	struct net_connection *con, *match = NULL;
 	struct udphdr *udp;
 	int port;
 
 	udp = (struct udphdr *)(ip + 1);
 	port = ntohs(udp->uh_dport);
-	list_for_each_entry(con, &connection_list, list) {
-		if (con->proto == IPPROTO_UDP && port == ntohs(con->udp->uh_sport)) {
+	list_for_each_entry(con, net_con_bucket(port), list) {
+		if (con->proto != IPPROTO_UDP || port != ntohs(con->udp->uh_sport))
+			continue;
+
+		if (!match)
+			match = con;
+
+		if (!edev || con->edev == edev) {
+			match = con;
+			break;
+		}
+	}
+
+	if (!match)
+		return -EINVAL;
+
+	match->handler(match->priv, pkt, len);
+
+	return 0;
+}
+
+static int net_handle_tcp(unsigned char *pkt, int len, unsigned int csum)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	struct net_connection *con;
+	IPaddr_t saddr = net_read_ip(&ip->saddr);
+
+	if (!(csum & NET_RX_CSUM_L4) &&
+	    net_tcp_checksum(ip, ntohs(ip->tot_len) - sizeof(struct iphdr)) != 0xffff)
+		return -EINVAL;
+
+	list_for_each_entry(con, net_con_bucket(ntohs(tcp->dest)), list) {
+		if (con->proto == IPPROTO_TCP &&
+		    tcp->dest == con->tcp->source &&
+		    tcp->source == con->tcp->dest &&
+		    saddr == net_read_ip(&con->ip->daddr)) {
 			con->handler(con->priv, pkt, len);
 			return 0;
 		}
@@ -565,13 +814,189 @@ static int net_handle_udp(unsigned char *pkt, int len)
 	return -EINVAL;
 }
 
+/*
+ * Multicast groups joined on an interface. Membership is announced with
+ * IGMPv2 reports (RFC 2236), so that switches doing IGMP snooping forward
+ * the group's traffic to us.
+ */
+struct net_mcast_group {
+	struct list_head list;
+	struct eth_device *edev;
+	IPaddr_t group;
+	int users;
+};
+
+static LIST_HEAD(net_mcast_groups);
+
+#define IGMP_ALL_HOSTS		htonl(0xe0000001)	/* 224.0.0.1 */
+#define IGMP_ALL_ROUTERS	htonl(0xe0000002)	/* 224.0.0.2 */
+
+static struct net_mcast_group *net_mcast_find(struct eth_device *edev,
+					      IPaddr_t group)
+{
+	struct net_mcast_group *g;
+
+	list_for_each_entry(g, &net_mcast_groups, list)
+		if (g->edev == edev && g->group == group)
+			return g;
+
+	return NULL;
+}
+
+static int igmp_send(struct eth_device *edev, int type, IPaddr_t group,
+		     IPaddr_t dest)
+{
+	static unsigned char *igmp_packet;
+	struct ethernet *et;
+	struct iphdr *ip;
+	struct igmphdr *igmp;
+	uint8_t *ra;
+
+	if (!igmp_packet) {
+		igmp_packet = net_alloc_packet();
+		if (!igmp_packet)
+			return -ENOMEM;
+	}
+
+	et = (struct ethernet *)igmp_packet;
+	net_ip_to_multicast_ether(dest, et->et_dest);
+	memcpy(et->et_src, edev->ethaddr, 6);
+	et->et_protlen = htons(PROT_IP);
+
+	/* IGMP messages carry the router alert option */
+	ip = (struct iphdr *)(igmp_packet + ETHER_HDR_SIZE);
+	ip->hl_v = 0x46;
+	ip->tos = 0xc0;
+	ip->tot_len = htons(sizeof(*ip) + 4 + sizeof(*igmp));
+	ip->id = htons(net_ip_id++);
+	ip->frag_off = htons(0x4000);
+	ip->ttl = 1;
+	ip->protocol = IPPROTO_IGMP;
+	net_copy_ip(&ip->saddr, &edev->ipaddr);
+	net_copy_ip(&ip->daddr, &dest);
+
+	ra = (uint8_t *)(ip + 1);
+	ra[0] = 0x94;
+	ra[1] = 4;
+	ra[2] = 0;
+	ra[3] = 0;
+
+	ip->check = 0;
+	ip->check = ~net_checksum((unsigned char *)ip, sizeof(*ip) + 4);
+
+	igmp = (struct igmphdr *)(ra + 4);
+	igmp->type = type;
+	igmp->code = 0;
+	net_copy_ip(&igmp->group, &group);
+	igmp->csum = 0;
+	igmp->csum = ~net_checksum((unsigned char *)igmp, sizeof(*igmp));
+
+	return eth_send(edev, igmp_packet,
+			ETHER_HDR_SIZE + sizeof(*ip) + 4 + sizeof(*igmp));
+}
+
+/**
+ * net_mcast_join - join a multicast group on an interface
+ * @edev: the interface
+ * @group: the group address
+ *
+ * Joining is reference counted, every successful call has to be balanced
+ * with net_mcast_leave().
+ */
+int net_mcast_join(struct eth_device *edev, IPaddr_t group)
+{
+	struct net_mcast_group *g;
+	int ret;
+
+	if (!net_ip_is_multicast(group) || group == IGMP_ALL_HOSTS)
+		return -EINVAL;
+
+	g = net_mcast_find(edev, group);
+	if (g) {
+		g->users++;
+		return 0;
+	}
+
+	g = xzalloc(sizeof(*g));
+	g->edev = edev;
+	g->group = group;
+	g->users = 1;
+	list_add_tail(&g->list, &net_mcast_groups);
+
+	eth_set_allmulti(edev, 1);
+
+	pr_debug("joining %pI4 on %s\n", &group, eth_name(edev));
+
+	ret = igmp_send(edev, IGMPV2_HOST_MEMBERSHIP_REPORT, group, group);
+	if (ret) {
+		eth_set_allmulti(edev, 0);
+		list_del(&g->list);
+		free(g);
+	}
+
+	return ret;
+}
+
+void net_mcast_leave(struct eth_device *edev, IPaddr_t group)
+{
+	struct net_mcast_group *g;
+
+	g = net_mcast_find(edev, group);
+	if (!g || --g->users)
+		return;
+
+	pr_debug("leaving %pI4 on %s\n", &group, eth_name(edev));
+
+	igmp_send(edev, IGMP_HOST_LEAVE_MESSAGE, group, IGMP_ALL_ROUTERS);
+
+	eth_set_allmulti(edev, 0);
+	list_del(&g->list);
+	free(g);
+}
+
+/*
+ * Answer membership queries right away instead of after a random delay,
+ * we are never a member of more than a few groups.
+ */
+static int net_handle_igmp(struct eth_device *edev, unsigned char *pkt,
+			   int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	int hlen = (ip->hl_v & 0x0f) * 4;
+	struct igmphdr *igmp = (struct igmphdr *)((unsigned char *)ip + hlen);
+	struct net_mcast_group *g;
+	IPaddr_t group;
+
+	if (ntohs(ip->tot_len) < hlen + sizeof(*igmp))
+		return -EINVAL;
+
+	if (!net_checksum_ok((unsigned char *)igmp,
+			     ntohs(ip->tot_len) - hlen))
+		return -EINVAL;
+
+	if (igmp->type != IGMP_HOST_MEMBERSHIP_QUERY)
+		return 0;
+
+	group = net_read_ip(&igmp->group);
+
+	list_for_each_entry(g, &net_mcast_groups, list) {
+		if (g->edev != edev || (group && group != g->group))
+			continue;
+
+		igmp_send(edev, IGMPV2_HOST_MEMBERSHIP_REPORT, g->group,
+			  g->group);
+	}
+
+	return 0;
+}
+
 static int net_handle_icmp(unsigned char *pkt, int len)
 {
 	struct net_connection *con;
 
 	pr_debug("%s\n", __func__);
 
-	list_for_each_entry(con, &connection_list, list) {
+	list_for_each_entry(con, net_con_bucket(0), list) {
 		if (con->proto == IPPROTO_ICMP) {
 			con->handler(con->priv, pkt, len);
 			return 0;
@@ -580,10 +1005,147 @@ static int net_handle_icmp(unsigned char *pkt, int len)
 	return 0;
 }
 
-static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
+/*
+ * IPv4 fragment reassembly. Up to IP_FRAG_MAX_DGRAMS datagrams can be
+ * reassembled at the same time. A datagram which is not complete after
+ * IP_FRAG_TIMEOUT is dropped, as is the oldest one when a fragment of
+ * another datagram arrives while all slots are in use.
+ */
+#define IP_FRAG_MAX_DGRAMS	4
+#define IP_FRAG_TIMEOUT		(2 * SECOND)
+#define IP_FRAG_MAX_PAYLOAD	(0xffff - sizeof(struct iphdr))
+#define IP_FRAG_UNITS		DIV_ROUND_UP(IP_FRAG_MAX_PAYLOAD, 8)
+
+#define IP_MF			0x2000	/* More fragments */
+#define IP_OFFSET		0x1fff	/* Fragment offset in 8 byte units */
+
+struct ip_frag {
+	int used;
+	uint64_t start;
+	IPaddr_t saddr;
+	uint16_t id;
+	uint8_t protocol;
+	int total;	/* Payload length, -1 until the last fragment is seen */
+	int units;	/* 8 byte units received */
+	unsigned long map[BITS_TO_LONGS(IP_FRAG_UNITS)];
+	/* ethernet and IP header followed by the reassembled payload */
+	unsigned char *buf;
+};
+
+static struct ip_frag ip_frags[IP_FRAG_MAX_DGRAMS];
+
+static struct ip_frag *ip_frag_find(struct iphdr *ip)
+{
+	struct ip_frag *frag, *victim = NULL;
+	IPaddr_t saddr = net_read_ip(&ip->saddr);
+	int i;
+
+	for (i = 0; i < IP_FRAG_MAX_DGRAMS; i++) {
+		frag = &ip_frags[i];
+
+		if (frag->used && is_timeout(frag->start, IP_FRAG_TIMEOUT)) {
+			pr_debug("%s: dropping incomplete datagram %d\n",
+				 __func__, ntohs(frag->id));
+			frag->used = 0;
+		}
+
+		if (frag->used && frag->saddr == saddr &&
+		    frag->id == ip->id && frag->protocol == ip->protocol)
+			return frag;
+
+		if (!victim || (victim->used &&
+				(!frag->used || frag->start < victim->start)))
+			victim = frag;
+	}
+
+	frag = victim;
+
+	if (!frag->buf)
+		frag->buf = xmemalign(32, ETHER_HDR_SIZE + sizeof(struct iphdr) +
+				      IP_FRAG_MAX_PAYLOAD);
+
+	frag->used = 1;
+	frag->start = get_time_ns();
+	frag->saddr = saddr;
+	frag->id = ip->id;
+	frag->protocol = ip->protocol;
+	frag->total = -1;
+	frag->units = 0;
+	memset(frag->map, 0, sizeof(frag->map));
+
+	return frag;
+}
+
+static int net_ip_reassemble(unsigned char *pkt, int len)
+{
+	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
+	int frag_off = ntohs(ip->frag_off);
+	int offset = (frag_off & IP_OFFSET) * 8;
+	int plen = ntohs(ip->tot_len) - sizeof(struct iphdr);
+	unsigned char *buf;
+	struct ip_frag *frag;
+	int i;
+
+	/* We only deal with option-less headers, like the rest of the stack */
+	if ((ip->hl_v & 0x0f) != 5 || plen <= 0 ||
+	    offset + plen > IP_FRAG_MAX_PAYLOAD)
+		goto bad;
+
+	/* All but the last fragment must carry a multiple of 8 bytes */
+	if ((frag_off & IP_MF) && (plen & 7))
+		goto bad;
+
+	frag = ip_frag_find(ip);
+	buf = frag->buf;
+
+	if (!offset)
+		memcpy(buf, pkt, ETHER_HDR_SIZE + sizeof(struct iphdr));
+
+	memcpy(buf + ETHER_HDR_SIZE + sizeof(struct iphdr) + offset,
+	       pkt + ETHER_HDR_SIZE + sizeof(struct iphdr), plen);
+
+	if (!(frag_off & IP_MF))
+		frag->total = offset + plen;
+
+	for (i = offset / 8; i < DIV_ROUND_UP(offset + plen, 8); i++)
+		if (!test_and_set_bit(i, frag->map))
+			frag->units++;
+
+	if (frag->total < 0 || !test_bit(0, frag->map) ||
+	    frag->units != DIV_ROUND_UP(frag->total, 8))
+		return 0;
+
+	frag->used = 0;
+
+	ip = (struct iphdr *)(buf + ETHER_HDR_SIZE);
+	ip->tot_len = htons(sizeof(struct iphdr) + frag->total);
+	ip->frag_off = 0;
+	ip->check = 0;
+	ip->check = ~net_checksum((unsigned char *)ip, sizeof(struct iphdr));
+
+	len = ETHER_HDR_SIZE + sizeof(struct iphdr) + frag->total;
+
+	switch (ip->protocol) {
+	case IPPROTO_ICMP:
+		return net_handle_icmp(buf, len);
+	case IPPROTO_UDP:
+		return net_handle_udp(NULL, buf, len);
+	case IPPROTO_TCP:
+		return net_handle_tcp(buf, len, 0);
+	}
+
+	return 0;
+bad:
+	net_bad_packet(pkt, len);
+	return 0;
+}
+
+static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len,
+			 unsigned int csum)
 {
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
 	IPaddr_t tmp;
+	int hlen;
 
 	pr_debug("%s\n", __func__);
 
@@ -596,20 +1158,40 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 	if ((ip->hl_v & 0xf0) != 0x40)
 		goto bad;
 
-	if (ip->frag_off & htons(0x1fff)) /* Can't deal w/ fragments */
+	/* the header may carry options, e.g. router alert in IGMP */
+	hlen = (ip->hl_v & 0x0f) * 4;
+	if (hlen < sizeof(struct iphdr) || hlen > ntohs(ip->tot_len))
 		goto bad;
-	if (!net_checksum_ok((unsigned char *)ip, sizeof(struct iphdr)))
+
+	if (!(csum & NET_RX_CSUM_IP) &&
+	    !net_checksum_ok((unsigned char *)ip, hlen))
 		goto bad;
 
+	/*
+	 * Only the IGMP handler skips the options, UDP, TCP, ICMP and the
+	 * fragment reassembly expect the payload right after struct iphdr.
+	 */
+	if (hlen != sizeof(struct iphdr) && ip->protocol != IPPROTO_IGMP)
+		return 0;
+
 	tmp = net_read_ip(&ip->daddr);
-	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST)
+	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST &&
+	    !(net_ip_is_multicast(tmp) &&
+	      (tmp == IGMP_ALL_HOSTS || net_mcast_find(edev, tmp))))
 		return 0;
 
+	if (ip->frag_off & htons(IP_MF | IP_OFFSET))
+		return net_ip_reassemble(pkt, len);
+
 	switch (ip->protocol) {
+	case IPPROTO_IGMP:
+		return net_handle_igmp(edev, pkt, len);
 	case IPPROTO_ICMP:
 		return net_handle_icmp(pkt, len);
 	case IPPROTO_UDP:
-		return net_handle_udp(pkt, len);
+		return net_handle_udp(edev, pkt, len);
+	case IPPROTO_TCP:
+		return net_handle_tcp(pkt, len, csum);
 	}
 
 	return 0;
@@ -618,7 +1200,8 @@ bad:
 	return 0;
 }
 
-int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
+int net_receive_csum(struct eth_device *edev, unsigned char *pkt, int len,
+		     unsigned int csum)
 {
 	struct ethernet *et = (struct ethernet *)pkt;
 	int et_protlen = ntohs(et->et_protlen);
@@ -636,7 +1219,7 @@ int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
 		ret = net_handle_arp(edev, pkt, len);
 		break;
 	case PROT_IP:
-		ret = net_handle_ip(edev, pkt, len);
+		ret = net_handle_ip(edev, pkt, len, csum);
 		break;
 	default:
 		pr_debug("%s: got unknown protocol type: %d\n", __func__, et_protlen);
@@ -647,6 +1230,11 @@ out:
 	return ret;
 }
 
+int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
+{
+	return net_receive_csum(edev, pkt, len, 0);
+}
+
 static int net_init(void)
 {
 	int i;
@@ -654,7 +1242,12 @@ static int net_init(void)
 	for (i = 0; i < PKTBUFSRX; i++)
 		NetRxPackets[i] = net_alloc_packet();
 
-	globalvar_add_simple_ip("net.nameserver", &net_nameserver);
+	for (i = 0; i < NET_CON_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&connection_hash[i]);
+
+	globalvar_add_simple_ip("net.nameserver", &net_nameserver[0]);
+	globalvar_add_simple_ip("net.nameserver2", &net_nameserver[1]);
+	globalvar_add_simple_ip("net.nameserver3", &net_nameserver[2]);
 	globalvar_add_simple_string("net.domainname", &net_domainname);
 	globalvar_add_simple_string("net.server", &net_server);
 	globalvar_add_simple_ip("net.gateway", &net_gateway);
@@ -665,5 +1258,7 @@ static int net_init(void)
 postcore_initcall(net_init);
 
 BAREBOX_MAGICVAR_NAMED(global_net_nameserver, global.net.nameserver, "The DNS server used for resolving host names");
+BAREBOX_MAGICVAR_NAMED(global_net_nameserver2, global.net.nameserver2, "Additional DNS server, queried in parallel");
+BAREBOX_MAGICVAR_NAMED(global_net_nameserver3, global.net.nameserver3, "Additional DNS server, queried in parallel");
 BAREBOX_MAGICVAR_NAMED(global_net_domainname, global.net.domainname, "Domain name used for DNS requests");
 BAREBOX_MAGICVAR_NAMED(global_net_server, global.net.server, "Standard server used for NFS/TFTP");
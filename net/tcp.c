@@ -0,0 +1,457 @@
+/*
+ * tcp.c - minimal TCP client
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Just enough TCP to pull large files from a server: active open only,
+ * one connection per tcp_open(), data sent by us is transmitted one
+ * segment at a time, while the receive side offers a large (scaled)
+ * window, acknowledges every second segment and delays lone
+ * acknowledgements for a short while. Out of order segments are dropped
+ * and answered with a duplicate ACK, which makes the peer retransmit.
+ */
+
+#define pr_fmt(fmt) "tcp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <net.h>
+#include <errno.h>
+#include <kfifo.h>
+#include <stdlib.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+#include <asm/unaligned.h>
+
+#define TCP_MSS			1460		/* What fits into an ethernet frame */
+#define TCP_DEFAULT_MSS		536		/* RFC 1122, if the peer sends no MSS */
+#define TCP_RCVBUF		SZ_128K		/* Receive buffer, power of two */
+#define TCP_WSCALE		2		/* TCP_RCVBUF >> TCP_WSCALE fits 16 bits */
+
+#define TCP_RTO			(500 * MSECOND)	/* Initial retransmission timeout */
+#define TCP_MAX_RETRIES		6
+#define TCP_DELACK_TIMEOUT	(40 * MSECOND)
+#define TCP_TIMEOUT		(10 * SECOND)	/* Give up when the peer is silent */
+
+#define TCP_OPT_END		0
+#define TCP_OPT_NOP		1
+#define TCP_OPT_MSS		2
+#define TCP_OPT_WSCALE		3
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_CLOSE_WAIT,		/* Peer has sent its FIN */
+	TCP_LAST_ACK,		/* ... and we have sent ours */
+};
+
+struct tcp_connection {
+	struct net_connection *con;
+	enum tcp_state state;
+	int err;
+
+	uint32_t snd_una;	/* Oldest unacknowledged sequence number */
+	uint32_t snd_nxt;	/* Next sequence number to send */
+	uint32_t snd_wnd;	/* Send window offered by the peer */
+	int snd_wscale;
+	int mss;
+
+	uint32_t rcv_nxt;	/* Next sequence number expected */
+	uint32_t rcv_wup;	/* rcv_nxt at the time of the last ACK sent */
+	uint32_t rcv_adv;	/* Window advertised with the last ACK */
+	int rcv_wscale;
+	struct kfifo *rx;
+
+	int unacked;		/* Segments received but not acknowledged */
+	uint64_t ack_time;	/* Arrival of the first of them */
+	uint64_t rx_time;	/* Last segment from the peer */
+};
+
+static inline int tcp_seq_after(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) > 0;
+}
+
+static uint32_t tcp_rcv_space(struct tcp_connection *tc)
+{
+	return TCP_RCVBUF - kfifo_len(tc->rx);
+}
+
+static int tcp_xmit(struct tcp_connection *tc, uint8_t flags, uint32_t seq,
+		    const void *data, int len)
+{
+	struct tcphdr *tcp = tc->con->tcp;
+	uint8_t *opt = (uint8_t *)(tcp + 1);
+	int hlen = sizeof(*tcp);
+	uint32_t win;
+
+	if (flags & TCP_FLAG_SYN) {
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		opt[4] = TCP_OPT_NOP;
+		opt[5] = TCP_OPT_WSCALE;
+		opt[6] = 3;
+		opt[7] = TCP_WSCALE;
+		hlen += 8;
+	}
+
+	/* The window in a SYN is never scaled, rcv_wscale is still 0 then */
+	win = min_t(uint32_t, tcp_rcv_space(tc) >> tc->rcv_wscale, 0xffff);
+
+	tcp->seq = htonl(seq);
+	tcp->ack_seq = (flags & TCP_FLAG_ACK) ? htonl(tc->rcv_nxt) : 0;
+	tcp->doff = (hlen / 4) << 4;
+	tcp->flags = flags;
+	tcp->window = htons(win);
+	tcp->urg_ptr = 0;
+
+	if (len)
+		memcpy((void *)tcp + hlen, data, len);
+
+	if (flags & TCP_FLAG_ACK) {
+		tc->unacked = 0;
+		tc->rcv_wup = tc->rcv_nxt;
+		tc->rcv_adv = win << tc->rcv_wscale;
+	}
+
+	return net_tcp_send(tc->con, hlen + len);
+}
+
+static void tcp_send_ack(struct tcp_connection *tc)
+{
+	tcp_xmit(tc, TCP_FLAG_ACK, tc->snd_nxt, NULL, 0);
+}
+
+static void tcp_parse_options(struct tcp_connection *tc, struct tcphdr *tcp,
+			      int hlen)
+{
+	uint8_t *opt = (uint8_t *)(tcp + 1);
+	uint8_t *end = (uint8_t *)tcp + hlen;
+	int wscale = -1;
+
+	while (opt < end) {
+		if (opt[0] == TCP_OPT_END)
+			break;
+		if (opt[0] == TCP_OPT_NOP) {
+			opt++;
+			continue;
+		}
+		if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+			break;
+
+		if (opt[0] == TCP_OPT_MSS && opt[1] == 4)
+			tc->mss = min_t(int, get_unaligned_be16(opt + 2), TCP_MSS);
+		if (opt[0] == TCP_OPT_WSCALE && opt[1] == 3)
+			wscale = min_t(int, opt[2], 14);
+
+		opt += opt[1];
+	}
+
+	/* Window scaling is only in effect when both sides asked for it */
+	if (wscale >= 0) {
+		tc->snd_wscale = wscale;
+		tc->rcv_wscale = TCP_WSCALE;
+	}
+}
+
+static void tcp_handler(void *ctx, char *packet, unsigned len)
+{
+	struct tcp_connection *tc = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(packet);
+	struct tcphdr *tcp = net_eth_to_tcphdr(packet);
+	int hlen = (tcp->doff >> 4) * 4;
+	int dlen = ntohs(ip->tot_len) - (int)sizeof(*ip) - hlen;
+	uint32_t seq = ntohl(tcp->seq);
+	uint32_t ack = ntohl(tcp->ack_seq);
+	uint8_t flags = tcp->flags;
+	unsigned int n;
+
+	if (hlen < sizeof(*tcp) || dlen < 0)
+		return;
+
+	if (flags & TCP_FLAG_RST) {
+		if (tc->state == TCP_SYN_SENT) {
+			if (!(flags & TCP_FLAG_ACK) || ack != tc->snd_nxt)
+				return;
+			tc->err = -ECONNREFUSED;
+		} else {
+			if (seq - tc->rcv_nxt > tcp_rcv_space(tc))
+				return;
+			tc->err = -ECONNRESET;
+		}
+		tc->state = TCP_CLOSED;
+		return;
+	}
+
+	switch (tc->state) {
+	case TCP_CLOSED:
+		return;
+	case TCP_SYN_SENT:
+		if ((flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) !=
+		    (TCP_FLAG_SYN | TCP_FLAG_ACK) || ack != tc->snd_nxt)
+			return;
+
+		tcp_parse_options(tc, tcp, hlen);
+		tc->rcv_nxt = seq + 1;
+		tc->snd_una = ack;
+		tc->snd_wnd = ntohs(tcp->window);
+		tc->rx_time = get_time_ns();
+		tc->state = TCP_ESTABLISHED;
+		tcp_send_ack(tc);
+		return;
+	default:
+		break;
+	}
+
+	tc->rx_time = get_time_ns();
+
+	if (flags & TCP_FLAG_ACK) {
+		if (tcp_seq_after(ack, tc->snd_una) &&
+		    !tcp_seq_after(ack, tc->snd_nxt))
+			tc->snd_una = ack;
+		tc->snd_wnd = ntohs(tcp->window) << tc->snd_wscale;
+	}
+
+	/* A retransmitted SYN-ACK, our ACK to it got lost */
+	if (flags & TCP_FLAG_SYN) {
+		tcp_send_ack(tc);
+		return;
+	}
+
+	if (!dlen && !(flags & TCP_FLAG_FIN))
+		return;
+
+	if (seq != tc->rcv_nxt || tc->state != TCP_ESTABLISHED) {
+		/* Out of order or duplicate, tell the peer what we expect */
+		tcp_send_ack(tc);
+		return;
+	}
+
+	n = kfifo_put(tc->rx, (void *)tcp + hlen, dlen);
+	tc->rcv_nxt += n;
+
+	if (n < dlen) {
+		/* Peer ignored our window, take what fits */
+		tcp_send_ack(tc);
+		return;
+	}
+
+	if (flags & TCP_FLAG_FIN) {
+		tc->rcv_nxt++;
+		tc->state = TCP_CLOSE_WAIT;
+		tcp_send_ack(tc);
+		return;
+	}
+
+	/* Delayed ACK: acknowledge every second segment right away */
+	if (!tc->unacked++)
+		tc->ack_time = get_time_ns();
+	if (tc->unacked >= 2)
+		tcp_send_ack(tc);
+}
+
+static int tcp_poll(struct tcp_connection *tc)
+{
+	if (ctrlc())
+		return -EINTR;
+
+	net_poll();
+
+	if (tc->unacked && is_timeout(tc->ack_time, TCP_DELACK_TIMEOUT))
+		tcp_send_ack(tc);
+
+	return 0;
+}
+
+/*
+ * tcp_xmit_wait - send a segment and wait until the peer acknowledged it,
+ * retransmitting with exponential backoff.
+ */
+static int tcp_xmit_wait(struct tcp_connection *tc, uint8_t flags,
+			 const void *data, int len)
+{
+	uint32_t seq = tc->snd_nxt;
+	uint64_t rto = TCP_RTO;
+	uint64_t start;
+	int tries = 0;
+	int ret;
+
+	tc->snd_nxt += len;
+	if (flags & (TCP_FLAG_SYN | TCP_FLAG_FIN))
+		tc->snd_nxt++;
+
+	tcp_xmit(tc, flags, seq, data, len);
+	start = get_time_ns();
+
+	while (tcp_seq_after(tc->snd_nxt, tc->snd_una)) {
+		if (tc->state == TCP_CLOSED)
+			return tc->err;
+
+		ret = tcp_poll(tc);
+		if (ret)
+			return ret;
+
+		if (is_timeout(start, rto)) {
+			if (++tries == TCP_MAX_RETRIES)
+				return -ETIMEDOUT;
+			pr_debug("retransmit %u\n", seq);
+			tcp_xmit(tc, flags, seq, data, len);
+			start = get_time_ns();
+			rto *= 2;
+		}
+	}
+
+	return 0;
+}
+
+static void tcp_free(struct tcp_connection *tc)
+{
+	net_unregister(tc->con);
+	kfifo_free(tc->rx);
+	free(tc);
+}
+
+/**
+ * tcp_open - open a TCP connection
+ * @dest: IP address of the server
+ * @dport: port to connect to
+ *
+ * Return: the connection or an ERR_PTR() on failure
+ */
+struct tcp_connection *tcp_open(IPaddr_t dest, uint16_t dport)
+{
+	struct tcp_connection *tc;
+	int ret;
+
+	tc = xzalloc(sizeof(*tc));
+
+	tc->rx = kfifo_alloc(TCP_RCVBUF);
+	if (!tc->rx) {
+		free(tc);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	tc->con = net_tcp_new(dest, dport, tcp_handler, tc);
+	if (IS_ERR(tc->con)) {
+		ret = PTR_ERR(tc->con);
+		kfifo_free(tc->rx);
+		free(tc);
+		return ERR_PTR(ret);
+	}
+
+	tc->mss = TCP_DEFAULT_MSS;
+	tc->snd_una = tc->snd_nxt = random32();
+	tc->state = TCP_SYN_SENT;
+
+	ret = tcp_xmit_wait(tc, TCP_FLAG_SYN, NULL, 0);
+	if (ret) {
+		tcp_free(tc);
+		return ERR_PTR(ret);
+	}
+
+	return tc;
+}
+
+/**
+ * tcp_write - send data
+ * @tc: the connection
+ * @buf: data to send
+ * @len: length of the data
+ *
+ * Blocks until all data has been acknowledged by the peer.
+ *
+ * Return: len or a negative error code
+ */
+int tcp_write(struct tcp_connection *tc, const void *buf, size_t len)
+{
+	size_t done = 0, now;
+	int ret;
+
+	while (done < len) {
+		if (tc->state != TCP_ESTABLISHED && tc->state != TCP_CLOSE_WAIT)
+			return tc->err ? tc->err : -ENOTCONN;
+
+		now = min_t(size_t, len - done, tc->mss);
+		if (tc->snd_wnd && now > tc->snd_wnd)
+			now = tc->snd_wnd;
+
+		ret = tcp_xmit_wait(tc, TCP_FLAG_ACK | TCP_FLAG_PSH,
+				    buf + done, now);
+		if (ret)
+			return ret;
+
+		done += now;
+	}
+
+	return len;
+}
+
+/**
+ * tcp_read - receive data
+ * @tc: the connection
+ * @buf: buffer for the data
+ * @len: size of the buffer
+ *
+ * Blocks until at least one byte is available.
+ *
+ * Return: number of bytes read, 0 when the peer closed the connection, or
+ * a negative error code
+ */
+int tcp_read(struct tcp_connection *tc, void *buf, size_t len)
+{
+	int ret;
+
+	while (!kfifo_len(tc->rx)) {
+		if (tc->state != TCP_ESTABLISHED)
+			return tc->err;
+
+		ret = tcp_poll(tc);
+		if (ret)
+			return ret;
+
+		if (is_timeout(tc->rx_time, TCP_TIMEOUT))
+			return -ETIMEDOUT;
+	}
+
+	ret = kfifo_get(tc->rx, buf, len);
+
+	/*
+	 * Tell the peer about the room we made once it is worth it, the
+	 * window may have been closed while nobody was reading.
+	 */
+	if (tc->state == TCP_ESTABLISHED &&
+	    (tc->rcv_nxt + tcp_rcv_space(tc)) - (tc->rcv_wup + tc->rcv_adv) >=
+	    TCP_RCVBUF / 2)
+		tcp_send_ack(tc);
+
+	return ret;
+}
+
+/**
+ * tcp_close - close a TCP connection
+ * @tc: the connection
+ *
+ * A connection which the peer has already closed is shut down gracefully.
+ * If the peer still has data for us, nobody is going to read it and the
+ * connection is reset instead.
+ */
+void tcp_close(struct tcp_connection *tc)
+{
+	if (tc->state == TCP_CLOSE_WAIT) {
+		tc->state = TCP_LAST_ACK;
+		tcp_xmit_wait(tc, TCP_FLAG_FIN | TCP_FLAG_ACK, NULL, 0);
+	} else if (tc->state == TCP_ESTABLISHED) {
+		tcp_xmit(tc, TCP_FLAG_RST | TCP_FLAG_ACK, tc->snd_nxt, NULL, 0);
+	}
+
+	tcp_free(tc);
+}
@@ -0,0 +1,533 @@
+/*
+ * tftpd.c - receive files pushed by a TFTP client
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Only write requests (RFC 1350) are served, with the blksize, tsize and
+ * windowsize options (RFC 2348, RFC 2349, RFC 7440). The received blocks
+ * are written to the destination file or device as they arrive.
+ */
+
+#define pr_fmt(fmt) "tftpd: " fmt
+
+#include <common.h>
+#include <command.h>
+#include <complete.h>
+#include <net.h>
+#include <clock.h>
+#include <fs.h>
+#include <errno.h>
+#include <libbb.h>
+#include <libfile.h>
+#include <libgen.h>
+#include <getopt.h>
+#include <linux/stat.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+
+#define TFTP_PORT		69
+
+#define TFTP_RRQ		1
+#define TFTP_WRQ		2
+#define TFTP_DATA		3
+#define TFTP_ACK		4
+#define TFTP_ERROR		5
+#define TFTP_OACK		6
+
+#define TFTP_ERR_NOTFOUND	1
+#define TFTP_ERR_DISKFULL	3
+
+#define TFTP_BLOCK_SIZE		512
+/* Largest block fitting into a 1500 byte MTU: 1500 - IP - UDP - TFTP header */
+#define TFTPD_MAX_BLOCKSIZE	1468
+/*
+ * Blocks are written out as they arrive, so the window size only limits
+ * how many frames the receive rings have to buffer between two polls.
+ */
+#define TFTPD_MAX_WINDOW_SIZE	16
+
+/* Resend the last ACK after this time without data from the client */
+#define TFTPD_RESEND_TIMEOUT	SECOND
+#define TFTPD_MAX_RESEND	5
+/* Time to wait for a resent last block after its ACK (RFC 1350, section 6) */
+#define TFTPD_DALLY_TIMEOUT	(2 * TFTPD_RESEND_TIMEOUT)
+
+enum tftpd_state {
+	TFTPD_IDLE,		/* waiting for a write request */
+	TFTPD_WRQ,		/* write request received, not answered yet */
+	TFTPD_DATA,		/* transfer in progress */
+	TFTPD_DALLY,		/* last block acknowledged, the ACK may get lost */
+	TFTPD_DONE,		/* transfer finished or aborted */
+};
+
+struct tftpd {
+	enum tftpd_state state;
+	const char *dest;
+	struct net_connection *con;
+
+	IPaddr_t client_ip;
+	uint16_t client_port;
+	char filename[256];
+
+	/* options requested by the client, 0 if not present */
+	int req_blocksize;
+	int req_windowsize;
+	loff_t req_tsize;
+	int has_tsize;
+	int oack;
+
+	int fd;
+	int blocksize;
+	int windowsize;
+	uint16_t last_block;
+	uint16_t acked_block;
+	int ack_pending;
+	int reack_sent;		/* gap in the window already acknowledged */
+	loff_t size;
+	int err;
+
+	uint64_t last_activity;
+	int resend;
+};
+
+static void tftpd_send_ack(struct tftpd *td)
+{
+	uint16_t *s = net_udp_get_payload(td->con);
+
+	s[0] = htons(TFTP_ACK);
+	s[1] = htons(td->last_block);
+
+	td->acked_block = td->last_block;
+	td->ack_pending = 0;
+
+	net_udp_send(td->con, 4);
+}
+
+static void tftpd_send_oack(struct tftpd *td)
+{
+	char *xp = net_udp_get_payload(td->con);
+	char *pkt = xp;
+
+	*(uint16_t *)pkt = htons(TFTP_OACK);
+	pkt += 2;
+
+	if (td->req_blocksize)
+		pkt += sprintf(pkt, "blksize%c%d", 0, td->blocksize) + 1;
+	if (td->req_windowsize)
+		pkt += sprintf(pkt, "windowsize%c%d", 0, td->windowsize) + 1;
+	if (td->has_tsize)
+		pkt += sprintf(pkt, "tsize%c%lld", 0, td->req_tsize) + 1;
+
+	net_udp_send(td->con, pkt - xp);
+}
+
+static void tftpd_send_error(struct tftpd *td, int code, const char *msg)
+{
+	char *pkt = net_udp_get_payload(td->con);
+
+	*(uint16_t *)pkt = htons(TFTP_ERROR);
+	*(uint16_t *)(pkt + 2) = htons(code);
+	strcpy(pkt + 4, msg);
+
+	net_udp_send(td->con, 4 + strlen(msg) + 1);
+}
+
+static int tftpd_parse_wrq(struct tftpd *td, char *pkt, int len)
+{
+	char *end = pkt + len;
+	char *opt, *val, *mode;
+
+	/* the request must be a list of NUL terminated strings */
+	if (len < 2 || end[-1] || !*pkt)
+		return -EINVAL;
+
+	strlcpy(td->filename, pkt, sizeof(td->filename));
+	mode = pkt + strlen(pkt) + 1;
+	if (mode >= end)
+		return -EINVAL;
+	if (strcasecmp(mode, "octet"))
+		pr_warn("mode '%s' not supported, using octet\n", mode);
+
+	td->req_blocksize = 0;
+	td->req_windowsize = 0;
+	td->has_tsize = 0;
+
+	opt = mode + strlen(mode) + 1;
+
+	while (opt < end) {
+		val = opt + strlen(opt) + 1;
+		if (val >= end)
+			break;
+
+		if (!strcasecmp(opt, "blksize"))
+			td->req_blocksize = simple_strtoul(val, NULL, 10);
+		else if (!strcasecmp(opt, "windowsize"))
+			td->req_windowsize = simple_strtoul(val, NULL, 10);
+		else if (!strcasecmp(opt, "tsize")) {
+			td->req_tsize = simple_strtoull(val, NULL, 10);
+			td->has_tsize = 1;
+		}
+
+		opt = val + strlen(val) + 1;
+	}
+
+	return 0;
+}
+
+/* Requests to the well known port */
+static void tftpd_listen_handler(void *ctx, char *packet, unsigned len)
+{
+	struct tftpd *td = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(packet);
+	struct udphdr *udp = net_eth_to_udphdr(packet);
+	char *pkt = net_eth_to_udp_payload(packet);
+	int plen = net_eth_to_udplen(packet);
+	uint16_t opcode;
+
+	/* One transfer at a time, the client retries its request */
+	if (td->state != TFTPD_IDLE || plen < 4)
+		return;
+
+	opcode = ntohs(*(uint16_t *)pkt);
+	if (opcode != TFTP_WRQ) {
+		pr_debug("ignoring opcode %d\n", opcode);
+		return;
+	}
+
+	if (tftpd_parse_wrq(td, pkt + 2, plen - 2))
+		return;
+
+	td->client_ip = net_read_ip(&ip->saddr);
+	td->client_port = ntohs(udp->uh_sport);
+	td->state = TFTPD_WRQ;
+}
+
+static void tftpd_data(struct tftpd *td, uint16_t block, void *data, int len)
+{
+	int ret;
+
+	if (td->state == TFTPD_DALLY) {
+		/* The client did not see our final ACK */
+		if (block == td->last_block)
+			td->ack_pending = 1;
+		return;
+	}
+
+	if (block != (uint16_t)(td->last_block + 1)) {
+		/*
+		 * A block got lost or the client resent blocks we already
+		 * have: acknowledge the last block received in sequence, so
+		 * that the client restarts the window from there. Once per
+		 * gap, the rest of the window is out of sequence as well.
+		 */
+		if (!td->reack_sent) {
+			td->ack_pending = 1;
+			td->reack_sent = 1;
+		}
+		return;
+	}
+
+	ret = write_full(td->fd, data, len);
+	if (ret < 0) {
+		td->err = ret;
+		tftpd_send_error(td, TFTP_ERR_DISKFULL, strerror(-ret));
+		td->state = TFTPD_DONE;
+		return;
+	}
+
+	td->last_block = block;
+	td->reack_sent = 0;
+	td->size += len;
+	td->last_activity = get_time_ns();
+	td->resend = 0;
+
+	if (len < td->blocksize) {
+		/* last block */
+		tftpd_send_ack(td);
+		td->state = TFTPD_DALLY;
+		return;
+	}
+
+	if ((uint16_t)(td->last_block - td->acked_block) >= td->windowsize)
+		td->ack_pending = 1;
+
+	if (td->size / SZ_1M != (td->size - len) / SZ_1M)
+		putchar('#');
+}
+
+/* Packets of the transfer, sent to our transfer identifier */
+static void tftpd_handler(void *ctx, char *packet, unsigned len)
+{
+	struct tftpd *td = ctx;
+	struct iphdr *ip = net_eth_to_iphdr(packet);
+	struct udphdr *udp = net_eth_to_udphdr(packet);
+	char *pkt = net_eth_to_udp_payload(packet);
+	int plen = net_eth_to_udplen(packet);
+
+	if ((td->state != TFTPD_DATA && td->state != TFTPD_DALLY) || plen < 4)
+		return;
+
+	if (net_read_ip(&ip->saddr) != td->client_ip ||
+	    ntohs(udp->uh_sport) != td->client_port)
+		return;
+
+	switch (ntohs(*(uint16_t *)pkt)) {
+	case TFTP_DATA:
+		tftpd_data(td, ntohs(*(uint16_t *)(pkt + 2)), pkt + 4,
+			   plen - 4);
+		break;
+	case TFTP_ERROR:
+		if (td->state == TFTPD_DALLY)
+			break;
+		pr_err("client error: '%s' (%d)\n", pkt + 4,
+		       ntohs(*(uint16_t *)(pkt + 2)));
+		td->err = -EIO;
+		td->state = TFTPD_DONE;
+		break;
+	}
+}
+
+static char *tftpd_dest_path(struct tftpd *td)
+{
+	struct stat s;
+
+	if (!stat(td->dest, &s) && S_ISDIR(s.st_mode))
+		return concat_path_file(td->dest, posix_basename(td->filename));
+
+	return xstrdup(td->dest);
+}
+
+static int tftpd_start(struct tftpd *td)
+{
+	char *path;
+	int ret;
+
+	td->con = net_udp_new(td->client_ip, td->client_port, tftpd_handler,
+			      td);
+	if (IS_ERR(td->con)) {
+		ret = PTR_ERR(td->con);
+		td->con = NULL;
+		return ret;
+	}
+
+	path = tftpd_dest_path(td);
+
+	td->fd = open_for_write(path, td->has_tsize ? td->req_tsize :
+				ERASE_SIZE_ALL);
+	if (td->fd < 0) {
+		ret = td->fd;
+		pr_err("could not open %s: %s\n", path, strerror(-ret));
+		tftpd_send_error(td, ret == -ENOENT ? TFTP_ERR_NOTFOUND :
+				 TFTP_ERR_DISKFULL, strerror(-ret));
+		goto out;
+	}
+
+	printf("receiving %s from %pI4 to %s\n", td->filename, &td->client_ip,
+	       path);
+	free(path);
+
+	td->blocksize = TFTP_BLOCK_SIZE;
+	if (td->req_blocksize)
+		td->blocksize = clamp_t(int, td->req_blocksize, 8,
+					TFTPD_MAX_BLOCKSIZE);
+	td->windowsize = 1;
+	if (td->req_windowsize)
+		td->windowsize = clamp(td->req_windowsize, 1,
+				       TFTPD_MAX_WINDOW_SIZE);
+
+	td->last_block = 0;
+	td->size = 0;
+	td->err = 0;
+	td->resend = 0;
+	td->last_activity = get_time_ns();
+	td->state = TFTPD_DATA;
+
+	td->oack = td->req_blocksize || td->req_windowsize || td->has_tsize;
+	if (td->oack)
+		tftpd_send_oack(td);
+	else
+		tftpd_send_ack(td);
+
+	/* The OACK is acknowledged by block 0, the first data is block 1 */
+	td->acked_block = 0;
+	td->ack_pending = 0;
+	td->reack_sent = 0;
+
+	return 0;
+out:
+	free(path);
+	net_unregister(td->con);
+	td->con = NULL;
+
+	return ret;
+}
+
+static void tftpd_finish(struct tftpd *td)
+{
+	int ret;
+
+	ret = close(td->fd);
+	if (!td->err && ret)
+		td->err = -errno;
+
+	net_unregister(td->con);
+	td->con = NULL;
+
+	if (td->err)
+		printf("\ntransfer of %s failed: %s\n", td->filename,
+		       strerror(-td->err));
+	else
+		printf("\nreceived %s, %lld bytes\n", td->filename, td->size);
+}
+
+static int do_tftpd(int argc, char *argv[])
+{
+	struct net_connection *listen_con;
+	struct eth_device *edev;
+	struct tftpd *td;
+	int opt, count = 1, done = 0, ret = 0;
+
+	while ((opt = getopt(argc, argv, "n:")) > 0) {
+		switch (opt) {
+		case 'n':
+			count = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind + 1 != argc)
+		return COMMAND_ERROR_USAGE;
+
+	/* Requests come in on the first configured interface */
+	edev = eth_get_first_configured();
+	if (!edev) {
+		printf("no configured network interface\n");
+		return COMMAND_ERROR;
+	}
+
+	/* Nothing is sent before the first request, so open the device now */
+	ret = eth_open(edev);
+	if (ret) {
+		printf("cannot open %s: %s\n", dev_name(&edev->dev),
+		       strerror(-ret));
+		return COMMAND_ERROR;
+	}
+
+	td = xzalloc(sizeof(*td));
+	td->dest = argv[optind];
+
+	listen_con = net_udp_eth_new(edev, IP_BROADCAST, 0, tftpd_listen_handler,
+				     td);
+	if (IS_ERR(listen_con)) {
+		ret = PTR_ERR(listen_con);
+		goto out;
+	}
+
+	net_udp_bind(listen_con, TFTP_PORT);
+
+	printf("waiting for TFTP write requests, ctrl-c to stop\n");
+
+	while (!count || done < count) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+
+		net_poll();
+
+		switch (td->state) {
+		case TFTPD_IDLE:
+			break;
+		case TFTPD_WRQ:
+			ret = tftpd_start(td);
+			if (ret) {
+				printf("cannot serve %s: %s\n", td->filename,
+				       strerror(-ret));
+				td->state = TFTPD_IDLE;
+			}
+			break;
+		case TFTPD_DATA:
+			if (td->ack_pending) {
+				tftpd_send_ack(td);
+				break;
+			}
+
+			if (!is_timeout(td->last_activity, TFTPD_RESEND_TIMEOUT))
+				break;
+
+			if (td->resend++ == TFTPD_MAX_RESEND) {
+				td->err = -ETIMEDOUT;
+				td->state = TFTPD_DONE;
+				break;
+			}
+
+			td->last_activity = get_time_ns();
+			td->reack_sent = 0;
+			/*
+			 * Without an OACK the client would fall back to the
+			 * default options, so resend it until data arrives.
+			 */
+			if (td->oack && !td->size)
+				tftpd_send_oack(td);
+			else
+				tftpd_send_ack(td);
+			break;
+		case TFTPD_DALLY:
+			if (td->ack_pending)
+				tftpd_send_ack(td);
+			if (is_timeout(td->last_activity, TFTPD_DALLY_TIMEOUT))
+				td->state = TFTPD_DONE;
+			break;
+		case TFTPD_DONE:
+			tftpd_finish(td);
+			ret = td->err;
+			done++;
+			td->state = TFTPD_IDLE;
+			break;
+		}
+	}
+
+	if (td->con) {
+		/* The file is complete when interrupted while dallying */
+		if (td->state != TFTPD_DALLY)
+			td->err = ret;
+		tftpd_finish(td);
+	}
+
+	net_unregister(listen_con);
+out:
+	free(td);
+
+	if (ret)
+		printf("tftpd: %s\n", strerror(-ret));
+
+	return ret ? COMMAND_ERROR : COMMAND_SUCCESS;
+}
+
+BAREBOX_CMD_HELP_START(tftpd)
+BAREBOX_CMD_HELP_TEXT("Receive files pushed by a TFTP client and write them to DEST.")
+BAREBOX_CMD_HELP_TEXT("DEST can be a file, a device or a directory. For a directory the")
+BAREBOX_CMD_HELP_TEXT("file name sent by the client is used within it. Devices are erased")
+BAREBOX_CMD_HELP_TEXT("before they are written.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-n COUNT", "exit after COUNT transfers, 0 for never (default 1)")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(tftpd)
+	.cmd		= do_tftpd,
+	BAREBOX_CMD_DESC("receive files from a TFTP client")
+	BAREBOX_CMD_OPTS("[-n COUNT] DEST")
+	BAREBOX_CMD_GROUP(CMD_GRP_NET)
+	BAREBOX_CMD_HELP(cmd_tftpd_help)
+	BAREBOX_CMD_COMPLETE(empty_complete)
+BAREBOX_CMD_END